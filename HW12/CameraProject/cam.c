@@ -1,4 +1,10 @@
 #include "cam.h"
+#include "pwm_solver.h"
+
+// MCLK divider and wrap, the OV7670 wants 10-48MHz. 18.75MHz is what it has
+// always run at; PCLK follows MCLK and each edge is a GPIO IRQ, so going faster
+// needs checking against captured frames first
+PWM_SOLVE(MCLK_PWM, SYS_CLK_HZ, 18750000, 2);
 
 void gpio_callback(uint gpio, uint32_t events) {
     if (gpio == VS){
@@ -80,15 +86,13 @@ void init_camera_pins(){
     gpio_set_dir(PWDN, GPIO_OUT);
     gpio_put(PWDN, 0);
 
-    // set MCLK to 50% 25MHz PWM -> actually only 18.75MHz
+    // set MCLK to 50% 18.75MHz PWM, 8 system clocks per period
     gpio_set_function(MCLK, GPIO_FUNC_PWM); // Set the LED Pin to be PWM
     uint slice_num = pwm_gpio_to_slice_num(MCLK); // Get PWM slice number
-    float div = 2; // must be between 1-255, 2 for 25MHz
-    pwm_set_clkdiv(slice_num, div); // divider
-    uint16_t wrap = 3; // when to rollover, must be less than 65535
-    pwm_set_wrap(slice_num, wrap);
+    pwm_set_clkdiv_int_frac(slice_num, MCLK_PWM_DIV_INT, MCLK_PWM_DIV_FRAC); // divider
+    pwm_set_wrap(slice_num, MCLK_PWM_WRAP);
     pwm_set_enabled(slice_num, true); // turn on the PWM
-    pwm_set_gpio_level(MCLK, wrap / 2); // set the duty cycle to 50%
+    pwm_set_gpio_level(MCLK, MCLK_PWM_TOP / 2); // set the duty cycle to 50%
 
     sleep_ms(1000); // give the camera time to get going
 
@@ -104,6 +108,7 @@ void init_camera_pins(){
     gpio_set_function(I2C_SCL, GPIO_FUNC_I2C);
     gpio_pull_up(I2C_SDA);
     gpio_pull_up(I2C_SCL);
+    i2c_bus_init(I2C_PORT, 100*1000);
     
     printf("Start init camera\n");
     init_camera();
@@ -257,15 +262,16 @@ void OV7670_write_register(uint8_t reg, uint8_t value){
     uint8_t buf[2];
     buf[0] = reg;
     buf[1] = value;
-    i2c_write_blocking(I2C_PORT, OV7670_ADDR, buf, 2, false);
+    i2c_bus_write(I2C_PORT, OV7670_ADDR, buf, 2);
     sleep_ms(1); // after each
 }
 
 // I2C read from the camera
 uint8_t OV7670_read_register(uint8_t reg){
     uint8_t buf;
-    i2c_write_blocking(I2C_PORT, OV7670_ADDR, &reg, 1, false);  // true to keep master control of bus
-    i2c_read_blocking(I2C_PORT, OV7670_ADDR, &buf, 1, false);  // false - finished with bus
+    // SCCB wants a stop between the address write and the read, no repeated start
+    i2c_bus_write(I2C_PORT, OV7670_ADDR, &reg, 1);
+    i2c_bus_read(I2C_PORT, OV7670_ADDR, &buf, 1);
     return buf;
 }
 
@@ -6,6 +6,7 @@
 #include "hardware/i2c.h"
 #include "hardware/gpio.h"
 #include "hardware/pwm.h"
+#include "i2c_bus.h"
 #include "ov7670.h"
 
 // I2C defines
@@ -0,0 +1,366 @@
+#include "i2c_bus.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/clocks.h"
+#include <string.h>
+
+#define FIFO_DEPTH 16
+
+const uint i2c_bus_speeds[] = {100*1000, 400*1000, 600*1000, 800*1000, 1000*1000};
+const uint i2c_bus_num_speeds = sizeof(i2c_bus_speeds) / sizeof(i2c_bus_speeds[0]);
+
+typedef struct {
+    uint8_t addr;
+    uint baud;
+} device_speed_t;
+
+typedef struct {
+    i2c_inst_t *i2c;
+    uint default_baud;
+    uint baud;        // what the hardware is set to now
+    device_speed_t devices[I2C_BUS_MAX_DEVICES];
+    uint num_devices;
+    i2c_xfer_t *head[2]; // [0] urgent, [1] everything else
+    i2c_xfer_t *tail[2];
+    i2c_xfer_t *active;
+    size_t cmd;       // commands pushed into the TX FIFO
+    size_t writes;    // header + tx bytes
+    size_t total;     // writes + reads
+    size_t received;
+    bool aborted;
+    uint64_t start_us;
+    i2c_bus_stats_t stats;
+} port_t;
+
+static port_t ports[2];
+static spin_lock_t *lock = NULL;
+
+// the data_cmd word for command i of the active transaction
+static uint32_t command(port_t *p, size_t i){
+    i2c_xfer_t *x = p->active;
+    uint32_t c;
+    if (i < x->header_len){
+        c = x->header[i];
+    }
+    else if (i < p->writes){
+        c = x->tx[i - x->header_len];
+    }
+    else {
+        c = I2C_IC_DATA_CMD_CMD_BITS;
+        if (i == p->writes && p->writes){
+            c |= I2C_IC_DATA_CMD_RESTART_BITS;
+        }
+    }
+    if (i == p->total - 1){
+        c |= I2C_IC_DATA_CMD_STOP_BITS;
+    }
+    return c;
+}
+
+// top up the TX FIFO. Every read command lands a byte in the RX FIFO, so never
+// have more reads outstanding than it can hold
+static void feed(port_t *p){
+    i2c_hw_t *hw = i2c_get_hw(p->i2c);
+    bool blocked = false;
+    while (p->cmd < p->total && hw->txflr < FIFO_DEPTH){
+        if (p->cmd >= p->writes && p->cmd - p->writes - p->received >= FIFO_DEPTH){
+            blocked = true; // RX_FULL calls back in once bytes arrive
+            break;
+        }
+        hw->data_cmd = command(p, p->cmd++);
+    }
+    if (p->cmd < p->total && !blocked){
+        hw->intr_mask |= I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+    }
+    else {
+        hw->intr_mask &= ~I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+    }
+}
+
+static void drain(port_t *p){
+    i2c_hw_t *hw = i2c_get_hw(p->i2c);
+    i2c_xfer_t *x = p->active;
+    while (hw->rxflr){
+        uint8_t b = (uint8_t)hw->data_cmd;
+        if (p->received < x->rx_len){
+            x->rx[p->received++] = b;
+        }
+    }
+}
+
+static uint speed_for(port_t *p, uint8_t addr){
+    for (uint i = 0; i < p->num_devices; i++){
+        if (p->devices[i].addr == addr){
+            return p->devices[i].baud;
+        }
+    }
+    return p->default_baud;
+}
+
+// called with the lock held
+static void start_next(port_t *p){
+    if (p->active){
+        return;
+    }
+    int q = p->head[0] ? 0 : 1;
+    i2c_xfer_t *x = p->head[q];
+    if (!x){
+        return;
+    }
+    p->head[q] = x->next;
+    if (!p->head[q]){
+        p->tail[q] = NULL;
+    }
+
+    p->active = x;
+    p->cmd = 0;
+    p->writes = x->header_len + x->tx_len;
+    p->total = p->writes + x->rx_len;
+    p->received = 0;
+    p->aborted = false;
+    p->start_us = time_us_64();
+    if (x->urgent){
+        uint32_t wait = (uint32_t)p->start_us - x->submit_us;
+        if (wait > p->stats.max_wait_us){
+            p->stats.max_wait_us = wait;
+        }
+    }
+
+    uint baud = speed_for(p, x->addr);
+    if (baud != p->baud){
+        i2c_set_baudrate(p->i2c, baud);
+        p->baud = baud;
+    }
+
+    i2c_hw_t *hw = i2c_get_hw(p->i2c);
+    hw->enable = 0;
+    hw->tar = x->addr;
+    hw->enable = 1;
+    hw->intr_mask = I2C_IC_INTR_MASK_M_STOP_DET_BITS | I2C_IC_INTR_MASK_M_TX_ABRT_BITS |
+                    (x->rx_len ? I2C_IC_INTR_MASK_M_RX_FULL_BITS : 0);
+    feed(p);
+}
+
+static void irq_handler(port_t *p){
+    i2c_hw_t *hw = i2c_get_hw(p->i2c);
+    // under the lock so a submit from the other core can't feed the FIFO at the same time
+    uint32_t save = spin_lock_blocking(lock);
+    uint32_t stat = hw->intr_stat;
+
+    if (stat & I2C_IC_INTR_STAT_R_TX_ABRT_BITS){
+        // the controller flushes the FIFO and sends a stop, finish on STOP_DET
+        (void)hw->clr_tx_abrt;
+        p->aborted = true;
+        p->cmd = p->total;
+        hw->intr_mask &= ~I2C_IC_INTR_MASK_M_TX_EMPTY_BITS;
+    }
+    if (stat & I2C_IC_INTR_STAT_R_RX_FULL_BITS){
+        drain(p);
+        feed(p);
+    }
+    if (stat & I2C_IC_INTR_STAT_R_TX_EMPTY_BITS){
+        feed(p);
+    }
+    if (!(stat & I2C_IC_INTR_STAT_R_STOP_DET_BITS) || !p->active){
+        spin_unlock(lock, save);
+        return;
+    }
+    (void)hw->clr_stop_det;
+    drain(p);
+
+    i2c_xfer_t *x = p->active;
+    p->active = NULL;
+    hw->intr_mask = 0;
+    p->stats.busy_us += time_us_64() - p->start_us;
+    if (p->aborted){
+        p->stats.aborts++;
+    }
+    else {
+        p->stats.completed++;
+    }
+    int result = p->aborted ? PICO_ERROR_GENERIC : (int)p->total;
+    spin_unlock(lock, save);
+
+    x->result = result;
+    x->complete = true;
+    if (x->done){
+        x->done(x);
+    }
+
+    save = spin_lock_blocking(lock);
+    start_next(p);
+    spin_unlock(lock, save);
+}
+
+static void i2c0_irq(){
+    irq_handler(&ports[0]);
+}
+
+static void i2c1_irq(){
+    irq_handler(&ports[1]);
+}
+
+void i2c_bus_init(i2c_inst_t *i2c, uint baud){
+    if (!lock){
+        lock = spin_lock_instance(spin_lock_claim_unused(true));
+    }
+    uint n = i2c_get_index(i2c);
+    port_t *p = &ports[n];
+    p->i2c = i2c;
+    p->head[0] = p->head[1] = NULL;
+    p->tail[0] = p->tail[1] = NULL;
+    p->active = NULL;
+    p->stats = (i2c_bus_stats_t){0};
+    p->default_baud = baud;
+    p->baud = baud;
+    p->num_devices = 0;
+
+    i2c_hw_t *hw = i2c_get_hw(i2c);
+    hw->intr_mask = 0;
+    hw->tx_tl = FIFO_DEPTH / 2; // refill once half empty
+    hw->rx_tl = 0;              // any byte received
+
+    uint irq = n ? I2C1_IRQ : I2C0_IRQ;
+    irq_set_exclusive_handler(irq, n ? i2c1_irq : i2c0_irq);
+    irq_set_enabled(irq, true);
+}
+
+void i2c_bus_submit(i2c_xfer_t *x){
+    hard_assert(x->header_len + x->tx_len + x->rx_len > 0);
+    x->complete = false;
+    x->next = NULL;
+    x->submit_us = time_us_32();
+
+    port_t *p = &ports[i2c_get_index(x->i2c)];
+    int q = x->urgent ? 0 : 1;
+    uint32_t save = spin_lock_blocking(lock);
+    if (p->tail[q]){
+        p->tail[q]->next = x;
+    }
+    else {
+        p->head[q] = x;
+    }
+    p->tail[q] = x;
+    start_next(p);
+    spin_unlock(lock, save);
+}
+
+int i2c_bus_wait(i2c_xfer_t *x){
+    while (!x->complete){
+        tight_loop_contents();
+    }
+    return x->result;
+}
+
+int i2c_bus_transfer(i2c_xfer_t *x){
+    i2c_bus_submit(x);
+    return i2c_bus_wait(x);
+}
+
+int i2c_bus_write(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len){
+    i2c_xfer_t x = {0};
+    x.i2c = i2c;
+    x.addr = addr;
+    x.tx = src;
+    x.tx_len = len;
+    return i2c_bus_transfer(&x);
+}
+
+int i2c_bus_read(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len){
+    i2c_xfer_t x = {0};
+    x.i2c = i2c;
+    x.addr = addr;
+    x.rx = dst;
+    x.rx_len = len;
+    int r = i2c_bus_transfer(&x);
+    return r < 0 ? r : (int)len;
+}
+
+int i2c_bus_read_reg(i2c_inst_t *i2c, uint8_t addr, uint8_t reg, uint8_t *dst, size_t len){
+    i2c_xfer_t x = {0};
+    x.i2c = i2c;
+    x.addr = addr;
+    x.header[0] = reg;
+    x.header_len = 1;
+    x.rx = dst;
+    x.rx_len = len;
+    int r = i2c_bus_transfer(&x);
+    return r < 0 ? r : (int)len;
+}
+
+uint i2c_bus_set_speed(i2c_inst_t *i2c, uint8_t addr, uint baud){
+    port_t *p = &ports[i2c_get_index(i2c)];
+    if (baud > I2C_BUS_MAX_BAUD){
+        baud = I2C_BUS_MAX_BAUD;
+    }
+
+    uint32_t save = spin_lock_blocking(lock);
+    uint i = 0;
+    while (i < p->num_devices && p->devices[i].addr != addr){
+        i++;
+    }
+    if (i == p->num_devices){
+        hard_assert(p->num_devices < I2C_BUS_MAX_DEVICES);
+        p->num_devices++;
+    }
+    p->devices[i].addr = addr;
+    p->devices[i].baud = baud;
+    spin_unlock(lock, save);
+
+    // same sums i2c_set_baudrate does, so the caller sees the real rate
+    uint period = (clock_get_hz(clk_sys) + baud / 2) / baud;
+    return clock_get_hz(clk_sys) / period;
+}
+
+uint i2c_bus_get_speed(i2c_inst_t *i2c, uint8_t addr){
+    port_t *p = &ports[i2c_get_index(i2c)];
+    uint32_t save = spin_lock_blocking(lock);
+    uint baud = speed_for(p, addr);
+    spin_unlock(lock, save);
+    return baud;
+}
+
+uint i2c_bus_probe(i2c_xfer_t *test, uint runs){
+    uint8_t reference[I2C_BUS_PROBE_MAX];
+    size_t compare = test->rx_len < I2C_BUS_PROBE_MAX ? test->rx_len : I2C_BUS_PROBE_MAX;
+    uint best = 0;
+
+    for (uint s = 0; s < i2c_bus_num_speeds; s++){
+        i2c_bus_set_speed(test->i2c, test->addr, i2c_bus_speeds[s]);
+        bool ok = true;
+        for (uint r = 0; r < runs && ok; r++){
+            if (i2c_bus_transfer(test) < 0){
+                ok = false;
+            }
+            else if (s == 0 && r == 0){
+                memcpy(reference, test->rx, compare);
+            }
+            else if (memcmp(reference, test->rx, compare) != 0){
+                ok = false;
+            }
+        }
+        if (!ok){
+            break;
+        }
+        best = i2c_bus_speeds[s];
+    }
+
+    if (best == 0){
+        // doesn't answer even at the slowest speed, leave it there
+        best = i2c_bus_speeds[0];
+    }
+    i2c_bus_set_speed(test->i2c, test->addr, best);
+    return best;
+}
+
+void i2c_bus_get_stats(i2c_inst_t *i2c, i2c_bus_stats_t *s){
+    uint32_t save = spin_lock_blocking(lock);
+    *s = ports[i2c_get_index(i2c)].stats;
+    spin_unlock(lock, save);
+}
+
+void i2c_bus_reset_stats(i2c_inst_t *i2c){
+    uint32_t save = spin_lock_blocking(lock);
+    ports[i2c_get_index(i2c)].stats = (i2c_bus_stats_t){0};
+    spin_unlock(lock, save);
+}
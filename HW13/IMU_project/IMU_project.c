@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
+#include "hardware/sync.h"
 #include "ssd1306.h"
+#include "i2c_bus.h"
 
 // I2C defines
 // This example will use I2C0 on GPIO8 (SDA) and GPIO9 (SCL) running at 400KHz.
@@ -32,8 +34,11 @@
 #define GYRO_ZOUT_H  0x47
 #define GYRO_ZOUT_L  0x48
 #define WHO_AM_I     0x68
+#define WHO_AM_I_REG 0x75
 
 #define NUM_BYTES 14
+#define IMU_RATE_HZ 1000
+#define PROBE_RUNS 50
 
 #define ACCEL_MAX 1
 
@@ -43,11 +48,18 @@
 void imu_init();
 void imu_read();
 void i2c_write(unsigned char address, unsigned char reg, unsigned char value);
-void i2c_burst_read(unsigned char address, unsigned char reg);
+void speedReport();
+bool imu_timer_callback(repeating_timer_t *t);
+void imu_read_done(i2c_xfer_t *x);
 void pixelArrayInit();
 void drawAccel();
 
-uint8_t burst_buf[NUM_BYTES];
+uint8_t burst_buf[NUM_BYTES]; // latest complete sample
+uint8_t imu_rx[NUM_BYTES];    // sample coming in
+i2c_xfer_t imu_xfer;
+volatile bool imu_busy = false;
+volatile uint32_t imu_reads = 0;
+repeating_timer_t imu_timer;
 
 float Xaccel;
 float Yaccel;
@@ -73,9 +85,36 @@ int main()
     gpio_pull_up(I2C_SCL);
     // For more examples of I2C use see https://github.com/raspberrypi/pico-examples/tree/master/i2c
 
-    ssd1306_setup();
+    // the OLED and the IMU share the bus through the interrupt driven queue
+    i2c_bus_init(I2C_PORT, 400*1000);
+
+    ssd1306_setup(I2C_PORT);
     pixelArrayInit();
     imu_init();
+
+    // give the terminal a few seconds to catch the table
+    for (int i = 0; i < 30 && !stdio_usb_connected(); i++) {
+        sleep_ms(100);
+    }
+    speedReport();
+
+    // then run each device at the fastest speed it handles
+    uint oledBaud = ssd1306_probe_speed(PROBE_RUNS);
+    i2c_xfer_t whoami = {0};
+    uint8_t id;
+    whoami.i2c = I2C_PORT;
+    whoami.addr = WHO_AM_I;
+    whoami.header[0] = WHO_AM_I_REG;
+    whoami.header_len = 1;
+    whoami.rx = &id;
+    whoami.rx_len = 1;
+    uint imuBaud = i2c_bus_probe(&whoami, PROBE_RUNS);
+    printf("OLED at %u Hz, IMU at %u Hz\n\r", oledBaud, imuBaud);
+
+    // read the IMU at 1kHz in the background, the reads jump the OLED's queue
+    add_repeating_timer_us(-1000000 / IMU_RATE_HZ, imu_timer_callback, NULL, &imu_timer);
+
+    uint64_t nextReport = time_us_64() + 1000000;
     
     while (true) {
         imu_read();
@@ -84,6 +123,16 @@ int main()
         drawAccel();
         ssd1306_drawPixel(1,1, 1);
         ssd1306_update();
+
+        if (time_us_64() > nextReport){
+            nextReport += 1000000;
+            i2c_bus_stats_t st;
+            i2c_bus_get_stats(I2C_PORT, &st);
+            i2c_bus_reset_stats(I2C_PORT);
+            printf("IMU reads/s: %lu, longest IMU wait: %lu us, aborts: %lu\n\r",
+                   (unsigned long)imu_reads, (unsigned long)st.max_wait_us, (unsigned long)st.aborts);
+            imu_reads = 0;
+        }
         
         sleep_ms(10);
     }
@@ -100,16 +149,80 @@ void imu_init(){
     i2c_write(WHO_AM_I, GYRO_CONFIG, 0b00011000);
 }
 
+// OLED frame rate and IMU read rate with both devices at each bus speed
+void speedReport(){
+    printf("%10s %10s %14s %8s\n\r", "I2C Hz", "OLED fps", "IMU reads/s", "errors");
+    for (uint s = 0; s < i2c_bus_num_speeds; s++){
+        uint baud = i2c_bus_speeds[s];
+        ssd1306_set_speed(baud);
+        i2c_bus_set_speed(I2C_PORT, WHO_AM_I, baud);
+        i2c_bus_reset_stats(I2C_PORT);
+
+        uint64_t start = time_us_64();
+        for (int i = 0; i < 20; i++){
+            ssd1306_update();
+        }
+        ssd1306_wait();
+        uint64_t frameTime = time_us_64() - start;
+
+        start = time_us_64();
+        for (int i = 0; i < 200; i++){
+            i2c_bus_read_reg(I2C_PORT, WHO_AM_I, ACCEL_XOUT_H, imu_rx, NUM_BYTES);
+        }
+        uint64_t readTime = time_us_64() - start;
+
+        i2c_bus_stats_t st;
+        i2c_bus_get_stats(I2C_PORT, &st);
+        printf("%10u %10.1f %14.0f %8lu\n\r", baud, 20e6 / frameTime, 200e6 / readTime,
+               (unsigned long)st.aborts);
+    }
+}
+
+// start a burst read of all the sensor registers, imu_read_done picks it up
+bool imu_timer_callback(repeating_timer_t *t){
+    if (imu_busy){
+        return true; // last one still queued, skip this tick
+    }
+    imu_busy = true;
+    imu_xfer = (i2c_xfer_t){0};
+    imu_xfer.i2c = I2C_PORT;
+    imu_xfer.addr = WHO_AM_I;
+    imu_xfer.header[0] = ACCEL_XOUT_H;
+    imu_xfer.header_len = 1;
+    imu_xfer.rx = imu_rx;
+    imu_xfer.rx_len = NUM_BYTES;
+    imu_xfer.urgent = true;
+    imu_xfer.done = imu_read_done;
+    i2c_bus_submit(&imu_xfer);
+    return true;
+}
+
+void imu_read_done(i2c_xfer_t *x){
+    if (x->result >= 0){
+        for (int i = 0; i < NUM_BYTES; i++){
+            burst_buf[i] = imu_rx[i];
+        }
+        imu_reads++;
+    }
+    imu_busy = false;
+}
+
 void imu_read(){
-    i2c_burst_read(WHO_AM_I, ACCEL_XOUT_H);
+    // latest sample, interrupts off so it can't change half way through
+    uint8_t sample[NUM_BYTES];
+    uint32_t save = save_and_disable_interrupts();
+    for (int i = 0; i < NUM_BYTES; i++){
+        sample[i] = burst_buf[i];
+    }
+    restore_interrupts(save);
 
-    Xaccel = (float)(((uint16_t)burst_buf[0] << 8) | (burst_buf[1]))*0.000061; 
-    Yaccel = (float)(((uint16_t)burst_buf[2] << 8) | (burst_buf[3]))*0.000061; 
-    Zaccel = (float)(((uint16_t)burst_buf[4] << 8) | (burst_buf[5]))*0.000061; 
+    Xaccel = (float)(((uint16_t)sample[0] << 8) | (sample[1]))*0.000061; 
+    Yaccel = (float)(((uint16_t)sample[2] << 8) | (sample[3]))*0.000061; 
+    Zaccel = (float)(((uint16_t)sample[4] << 8) | (sample[5]))*0.000061; 
 
-    Xpos = (float)(((uint16_t)burst_buf[8] << 8) | (burst_buf[9]))*0.007630;
-    Ypos = (float)(((uint16_t)burst_buf[10] << 8) | (burst_buf[11]))*0.007630;
-    Zpos = (float)(((uint16_t)burst_buf[12] << 8) | (burst_buf[13]))*0.007630;  
+    Xpos = (float)(((uint16_t)sample[8] << 8) | (sample[9]))*0.007630;
+    Ypos = (float)(((uint16_t)sample[10] << 8) | (sample[11]))*0.007630;
+    Zpos = (float)(((uint16_t)sample[12] << 8) | (sample[13]))*0.007630;  
 
     }
 
@@ -117,12 +230,7 @@ void i2c_write(unsigned char address, unsigned char reg, unsigned char value) {
     unsigned char buf[2];
     buf[0] = reg;
     buf[1] = value;
-    i2c_write_blocking(i2c_default, address, buf, 2, false);
-}
-
-void i2c_burst_read(unsigned char address, unsigned char reg){
-    i2c_write_blocking(i2c_default, address, &reg, 1, true);  // true to keep master control of bus
-    i2c_read_blocking(i2c_default, address, burst_buf, NUM_BYTES, false);  // false - finished with bus
+    i2c_bus_write(I2C_PORT, address, buf, 2);
 }
 
 void pixelArrayInit(){
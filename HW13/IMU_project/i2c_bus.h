@@ -0,0 +1,85 @@
+#ifndef I2C_BUS_H__
+#define I2C_BUS_H__
+
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
+// Queued, interrupt driven I2C transactions.
+// A transaction is a descriptor: an optional few header bytes (register address,
+// control byte), then tx bytes, then, after a repeated start, rx bytes. The I2C IRQ
+// feeds the FIFOs and calls the completion callback, so submitting never blocks.
+// Each port runs one transaction at a time; urgent ones (a 1kHz sensor read) go
+// ahead of everything queued at the next transaction boundary, so long writes
+// should be split into a few short transactions. The queues sit behind a spin
+// lock, so either core (or an IRQ) can submit.
+//
+// Each address can have its own clock speed (up to 1MHz fast mode plus, which
+// wants stronger pull-ups than the usual 4.7k); the engine switches between
+// transactions. i2c_bus_probe() finds the fastest speed a device handles reliably.
+//
+// i2c_init() the port and set up its pins first, then i2c_bus_init().
+
+#define I2C_BUS_MAX_HEADER  4
+#define I2C_BUS_MAX_DEVICES 8    // addresses per port with their own speed
+#define I2C_BUS_MAX_BAUD    (1000*1000)
+#define I2C_BUS_PROBE_MAX   32   // most bytes a probe transaction can compare
+
+struct i2c_xfer;
+typedef void (*i2c_xfer_cb_t)(struct i2c_xfer *xfer);
+
+typedef struct i2c_xfer {
+    i2c_inst_t *i2c;
+    uint8_t addr;                        // 7 bit address
+    uint8_t header[I2C_BUS_MAX_HEADER];  // written first
+    uint header_len;
+    const uint8_t *tx;                   // then these
+    size_t tx_len;
+    uint8_t *rx;                         // then a repeated start (if anything was written) and a read
+    size_t rx_len;
+    bool urgent;                         // jump the queue
+    i2c_xfer_cb_t done;                  // called from the I2C IRQ, may submit more transfers
+    void *user;
+    volatile bool complete;
+    volatile int result;                 // bytes moved, or PICO_ERROR_GENERIC on a NACK/abort
+    uint32_t submit_us;
+    struct i2c_xfer *next;
+} i2c_xfer_t;
+
+typedef struct {
+    uint32_t completed;
+    uint32_t aborts;        // NACKs and lost arbitration
+    uint32_t max_wait_us;   // longest an urgent transaction sat in the queue
+    uint64_t busy_us;
+} i2c_bus_stats_t;
+
+// baud is the speed the port was i2c_init'd at, used for addresses without their own
+void i2c_bus_init(i2c_inst_t *i2c, uint baud);
+// run every transaction to addr at baud, returns the speed the hardware actually gives
+uint i2c_bus_set_speed(i2c_inst_t *i2c, uint8_t addr, uint baud);
+uint i2c_bus_get_speed(i2c_inst_t *i2c, uint8_t addr);
+// run the test transaction runs times at each speed in i2c_bus_speeds from the slowest
+// up and keep the fastest that never NACKs and (for reads) always matches what came
+// back at the slowest speed. The test has to be safe to repeat. Sets and returns that speed
+uint i2c_bus_probe(i2c_xfer_t *test, uint runs);
+
+// the speeds the probe steps through, slowest first
+extern const uint i2c_bus_speeds[];
+extern const uint i2c_bus_num_speeds;
+
+// queue a transaction, returns straight away
+void i2c_bus_submit(i2c_xfer_t *xfer);
+// wait for a submitted transaction, don't call from an IRQ
+int i2c_bus_wait(i2c_xfer_t *xfer);
+// submit and wait, returns xfer->result
+int i2c_bus_transfer(i2c_xfer_t *xfer);
+
+// blocking helpers in the style of i2c_write_blocking
+int i2c_bus_write(i2c_inst_t *i2c, uint8_t addr, const uint8_t *src, size_t len);
+int i2c_bus_read(i2c_inst_t *i2c, uint8_t addr, uint8_t *dst, size_t len);
+// write reg, repeated start, read len bytes
+int i2c_bus_read_reg(i2c_inst_t *i2c, uint8_t addr, uint8_t reg, uint8_t *dst, size_t len);
+
+void i2c_bus_get_stats(i2c_inst_t *i2c, i2c_bus_stats_t *stats);
+void i2c_bus_reset_stats(i2c_inst_t *i2c);
+
+#endif
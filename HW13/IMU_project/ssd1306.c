@@ -4,11 +4,22 @@
 #include "ssd1306.h"
 #include "hardware/i2c.h"
 #include "pico/stdlib.h"
+#include "i2c_bus.h"
+
+#define SSD1306_CHUNK 32 // pixel bytes per transaction, short enough not to hold up an urgent read
 
 unsigned char SSD1306_ADDRESS = 0b0111100; // 7bit i2c address
 unsigned char ssd1306_buffer[513]; // 128x32/8. Every bit is a pixel except first byte
 
-void ssd1306_setup() {
+static i2c_inst_t *ssd1306_i2c;
+static unsigned char flush_buf[512]; // copy of the frame being sent, drawing can carry on
+static i2c_xfer_t window_xfer;
+static i2c_xfer_t pixel_xfer[512 / SSD1306_CHUNK];
+static bool flushing = false;
+static const unsigned char window[] = {SSD1306_PAGEADDR, 0, 0xFF, SSD1306_COLUMNADDR, 0, 128 - 1};
+
+void ssd1306_setup(i2c_inst_t *i2c) {
+    ssd1306_i2c = i2c;
     // first byte in ssd1306_buffer is a command
     ssd1306_buffer[0] = 0x40;
     // give a little delay for the ssd1306 to power up
@@ -54,32 +65,70 @@ void ssd1306_command(unsigned char c) {
     uint8_t buf[2];
     buf[0] = 0x00;
     buf[1] =c;
-    i2c_write_blocking(i2c_default, SSD1306_ADDRESS, buf, 2, false);
+    i2c_bus_write(ssd1306_i2c, SSD1306_ADDRESS, buf, 2);
 }
 
-// update every pixel on the screen
+// update every pixel on the screen. Returns once the frame is queued, the
+// transfer runs from the I2C interrupt
 void ssd1306_update() {
-    ssd1306_command(SSD1306_PAGEADDR);
-    ssd1306_command(0);
-    ssd1306_command(0xFF);
-    ssd1306_command(SSD1306_COLUMNADDR);
-    ssd1306_command(0);
-    ssd1306_command(128 - 1); // Width
-
-    unsigned short count = 512; // WIDTH * ((HEIGHT + 7) / 8)
-    unsigned char * ptr = ssd1306_buffer; // first address of the pixel buffer
-    /*
-    i2c_master_start();
-    i2c_master_send(ssd1306_write);
-    i2c_master_send(0x40); // send pixel data
-    // send every pixel
-    while (count--) {
-        i2c_master_send(*ptr++);
+    ssd1306_wait(); // the last frame has to be out before flush_buf is reused
+    memcpy(flush_buf, ssd1306_buffer + 1, 512);
+
+    // all 6 addressing commands in one transaction, 0x00 says commands follow
+    window_xfer = (i2c_xfer_t){0};
+    window_xfer.i2c = ssd1306_i2c;
+    window_xfer.addr = SSD1306_ADDRESS;
+    window_xfer.header[0] = 0x00;
+    window_xfer.header_len = 1;
+    window_xfer.tx = window;
+    window_xfer.tx_len = sizeof(window);
+    i2c_bus_submit(&window_xfer);
+
+    // pixels in chunks, each one starts with 0x40 (pixel data) and the display's
+    // address pointer carries on from the last one
+    for (int i = 0; i < 512 / SSD1306_CHUNK; i++) {
+        i2c_xfer_t *x = &pixel_xfer[i];
+        *x = (i2c_xfer_t){0};
+        x->i2c = ssd1306_i2c;
+        x->addr = SSD1306_ADDRESS;
+        x->header[0] = 0x40;
+        x->header_len = 1;
+        x->tx = &flush_buf[i * SSD1306_CHUNK];
+        x->tx_len = SSD1306_CHUNK;
+        i2c_bus_submit(x);
     }
-    i2c_master_stop();
-    */
+    flushing = true;
+}
+
+// find the fastest clock the display takes, rewriting the contrast setting as the test
+uint ssd1306_probe_speed(uint runs) {
+    static const unsigned char contrast[] = {SSD1306_SETCONTRAST, 0x8F};
+    ssd1306_wait();
+    i2c_xfer_t x = {0};
+    x.i2c = ssd1306_i2c;
+    x.addr = SSD1306_ADDRESS;
+    x.header[0] = 0x00;
+    x.header_len = 1;
+    x.tx = contrast;
+    x.tx_len = sizeof(contrast);
+    return i2c_bus_probe(&x, runs);
+}
+
+// run the display at baud from now on
+void ssd1306_set_speed(uint baud) {
+    ssd1306_wait();
+    i2c_bus_set_speed(ssd1306_i2c, SSD1306_ADDRESS, baud);
+}
 
-    i2c_write_blocking(i2c_default, SSD1306_ADDRESS, ptr, 513, false);
+// true while a frame is still going out
+bool ssd1306_busy() {
+    return flushing && !pixel_xfer[512 / SSD1306_CHUNK - 1].complete;
+}
+
+void ssd1306_wait() {
+    while (ssd1306_busy()) {
+        tight_loop_contents();
+    }
 }
 
 // set a pixel value. Call update() to push to the display)
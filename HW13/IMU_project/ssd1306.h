@@ -1,6 +1,9 @@
 #ifndef SSD1306_H__
 #define SSD1306_H__
 
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
 // Based on the adafruit and sparkfun libraries
 #define SSD1306_MEMORYMODE          0x20 
 #define SSD1306_COLUMNADDR          0x21 
@@ -23,8 +26,15 @@
 #define SSD1306_SETSTARTLINE        0x40 
 #define SSD1306_DEACTIVATE_SCROLL   0x2E ///< Stop scroll
 
-void ssd1306_setup(void);
+// i2c_bus_init(i2c) first
+void ssd1306_setup(i2c_inst_t *i2c);
+// queue the frame and return, the I2C interrupt sends it
 void ssd1306_update(void);
+bool ssd1306_busy(void);
+void ssd1306_wait(void);
+// fastest I2C clock the display takes without a NACK, and switch to it
+uint ssd1306_probe_speed(uint runs);
+void ssd1306_set_speed(uint baud);
 void ssd1306_clear(void);
 void ssd1306_drawPixel(unsigned char x, unsigned char y, unsigned char color);
 
@@ -2,14 +2,17 @@
 #include <stdlib.h>
 #include "pico/stdlib.h"
 #include "hardware/pwm.h"
+#include "pwm_solver.h"
 
 #define PHASE_PIN 16
 #define ENABLE_PIN 17
 
 #define FREQ 75 //kHz
 
+// divider and wrap for FREQ, at least 1% duty steps
+PWM_SOLVE(MOTOR_PWM, SYS_CLK_HZ, FREQ * 1000, 100);
+
 int dutyCycle = 0;
-int cycleTime = (float)(1/(FREQ*1000)) * 1000000; //us
 
 
 int main()
@@ -23,10 +26,8 @@ int main()
     gpio_set_function(ENABLE_PIN, GPIO_FUNC_PWM);
 
     uint slice_num = pwm_gpio_to_slice_num(ENABLE_PIN); // Get PWM slice number
-    float div = 2; // must be between 1-255
-    pwm_set_clkdiv(slice_num, div); // divider
-    uint16_t wrap = 1000; // when to rollover, must be less than 65535
-    pwm_set_wrap(slice_num, wrap);
+    pwm_set_clkdiv_int_frac(slice_num, MOTOR_PWM_DIV_INT, MOTOR_PWM_DIV_FRAC); // divider
+    pwm_set_wrap(slice_num, MOTOR_PWM_WRAP); // when to rollover
     pwm_set_enabled(slice_num, true); // turn on the PWM
 
     pwm_set_gpio_level(ENABLE_PIN, 0); // set the duty cycle to 0%
@@ -44,7 +45,7 @@ int main()
                 dutyCycle -= 1;
                 printf("Duty Cycle: %d\n\r", dutyCycle);
             }
-            pwm_set_gpio_level(ENABLE_PIN, wrap*abs(dutyCycle)/100);           
+            pwm_set_gpio_level(ENABLE_PIN, MOTOR_PWM_TOP*abs(dutyCycle)/100);           
         }
         if (dutyCycle > 0){
             gpio_put(PHASE_PIN, 0);
@@ -0,0 +1,149 @@
+#include "dac_dma.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+
+static spi_inst_t *dac_spi;
+static uint dac_cs;
+
+// data channel streams frames into the SPI FIFO, one per pacing timer tick.
+// when it runs out it chains to the control channel, which writes the start of
+// the buffer back into the data channel's read address trigger to loop.
+static int data_chan;
+static int ctrl_chan;
+static int pace_timer;
+static dma_channel_config data_config;
+static const uint16_t *loop_start;
+static bool running = false;
+
+void dac_dma_init(spi_inst_t *spi, uint cs_pin){
+    dac_spi = spi;
+    dac_cs = cs_pin;
+    data_chan = dma_claim_unused_channel(true);
+    ctrl_chan = dma_claim_unused_channel(true);
+    pace_timer = dma_claim_unused_timer(true);
+}
+
+uint16_t dac_frame(int channel, uint16_t code){
+    if (code > DAC_MAX_CODE){
+        code = DAC_MAX_CODE;
+    }
+    uint16_t frame = DAC_CONFIG_BITS | (code << 2);
+    if (channel){
+        frame |= DAC_CHANNEL_BIT;
+    }
+    return frame;
+}
+
+uint16_t dac_voltage_frame(int channel, float voltage, float vref){
+    if (voltage < 0){
+        voltage = 0;
+    }
+    return dac_frame(channel, (uint16_t)(voltage * 1024.0f / vref));
+}
+
+// the pacing timer ticks at clk_sys * num / den, find the closest 16 bit fraction
+// the slowest is clk_sys / 0xFFFF (~2.3kHz at 150MHz), returns 0 for anything
+// out of reach
+static uint32_t set_pace(uint32_t sample_rate){
+    uint64_t clk = clock_get_hz(clk_sys);
+    if (sample_rate == 0 || sample_rate > clk || (uint64_t)sample_rate * 0xFFFF < clk){
+        return 0;
+    }
+    uint32_t best_num = 1;
+    uint32_t best_den = 0xFFFF;
+    uint64_t best_err = UINT64_MAX;
+
+    for (uint32_t num = 1; num <= 0xFFFF; num++){
+        uint64_t den = (clk * num + sample_rate / 2) / sample_rate;
+        if (den > 0xFFFF){
+            break;
+        }
+        if (den < num){
+            continue;
+        }
+        // compare |clk*num/den - rate| without dividing
+        uint64_t target = (uint64_t)sample_rate * den;
+        uint64_t err = clk * num > target ? clk * num - target : target - clk * num;
+        if (best_err == UINT64_MAX || err * best_den < best_err * den){
+            best_err = err;
+            best_num = num;
+            best_den = den;
+        }
+        if (err == 0){
+            break;
+        }
+    }
+
+    dma_timer_set_fraction(pace_timer, best_num, best_den);
+    return (uint32_t)(clk * best_num / best_den);
+}
+
+uint32_t dac_dma_start(const uint16_t *frames, uint count, uint32_t sample_rate){
+    if (running){
+        dac_dma_stop();
+    }
+
+    uint32_t rate = set_pace(sample_rate);
+    if (rate == 0){
+        return 0;
+    }
+
+    // 16 bit frames with CPHA 0 make the SPI block pulse CSn between frames,
+    // which is exactly the rising edge the MCP4912 latches on
+    spi_set_format(dac_spi, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    gpio_set_function(dac_cs, GPIO_FUNC_SPI);
+
+    loop_start = frames;
+
+    data_config = dma_channel_get_default_config(data_chan);
+    channel_config_set_transfer_data_size(&data_config, DMA_SIZE_16);
+    channel_config_set_read_increment(&data_config, true);
+    channel_config_set_write_increment(&data_config, false);
+    channel_config_set_dreq(&data_config, dma_get_timer_dreq(pace_timer));
+    channel_config_set_chain_to(&data_config, ctrl_chan);
+    dma_channel_configure(data_chan, &data_config,
+                          &spi_get_hw(dac_spi)->dr,
+                          frames,
+                          count,
+                          false);
+
+    dma_channel_config ctrl_config = dma_channel_get_default_config(ctrl_chan);
+    channel_config_set_transfer_data_size(&ctrl_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&ctrl_config, false);
+    channel_config_set_write_increment(&ctrl_config, false);
+    dma_channel_configure(ctrl_chan, &ctrl_config,
+                          &dma_hw->ch[data_chan].al3_read_addr_trig,
+                          &loop_start,
+                          1,
+                          false);
+
+    running = true;
+    dma_channel_start(data_chan);
+    return rate;
+}
+
+void dac_dma_stop(void){
+    if (!running){
+        return;
+    }
+    // chaining to itself disables the chain, so the loop can't restart under us
+    channel_config_set_chain_to(&data_config, data_chan);
+    dma_channel_set_config(data_chan, &data_config, false);
+    dma_channel_abort(ctrl_chan);
+    dma_channel_abort(data_chan);
+
+    while (spi_is_busy(dac_spi)){
+        tight_loop_contents();
+    }
+
+    // hand chip select back to software (driven high) and go back to byte frames
+    gpio_put(dac_cs, 1);
+    gpio_set_dir(dac_cs, GPIO_OUT);
+    gpio_set_function(dac_cs, GPIO_FUNC_SIO);
+    spi_set_format(dac_spi, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    running = false;
+}
+
+bool dac_dma_running(void){
+    return running;
+}
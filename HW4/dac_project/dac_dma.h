@@ -0,0 +1,32 @@
+#ifndef DAC_DMA_H__
+#define DAC_DMA_H__
+
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+
+// MCP4912 16 bit command word:
+// bit 15 channel (0 = A, 1 = B), bit 14 BUF, bit 13 GA (1 = 1x), bit 12 SHDN (1 = active)
+// bits 11-2 are the 10 bit value, bits 1-0 are ignored
+#define DAC_CONFIG_BITS 0x7000
+#define DAC_CHANNEL_BIT 0x8000
+#define DAC_MAX_CODE    1023
+
+// Output path that streams preformatted frames from a buffer into the SPI TX FIFO.
+// A DMA pacing timer sets the sample clock and the SPI block drives chip select
+// in hardware (16 bit frames, CPHA 0 pulses CSn between every frame), so the CPU
+// does nothing per sample.
+
+void dac_dma_init(spi_inst_t *spi, uint cs_pin);
+
+// build a ready to send SPI frame
+uint16_t dac_frame(int channel, uint16_t code);
+uint16_t dac_voltage_frame(int channel, float voltage, float vref);
+
+// play count frames over and over at sample_rate (Hz), returns the rate actually
+// set. The pacing timer can't go below clk_sys / 65535 (~2.3kHz at 150MHz), a
+// rate under that returns 0 and plays nothing
+uint32_t dac_dma_start(const uint16_t *frames, uint count, uint32_t sample_rate);
+void dac_dma_stop(void);
+bool dac_dma_running(void);
+
+#endif
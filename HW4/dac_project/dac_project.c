@@ -1,7 +1,9 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "hardware/spi.h"
+#include "hardware/sync.h"
 #include "math.h"
+#include "dac_dma.h"
 
 // SPI Defines
 // We are going to use SPI 0, and allocate it to the following GPIO pins
@@ -12,20 +14,18 @@
 #define PIN_SCK  18
 #define PIN_MOSI 19
 #define VREF 3.3 // V
-#define TMAX 1000.0 // 6666
+#define SAMPLE_RATE 50000 // Hz, set by the DMA pacing timer
+#define NUM_SAMPLES 1000 // one period of the wave -> 50Hz
 
-
-void writeDac(int channel, float voltage);
-
-static inline void cs_select(uint pin);
-static inline void cs_deselect(uint pin);
+static uint16_t wave[NUM_SAMPLES]; // preformatted SPI frames
 
 int main()
 {
     stdio_init_all();
 
-    // SPI initialisation. This example will use SPI at 1MHz.
-    spi_init(SPI_PORT, 1000*1000);
+    // SPI initialisation. This example will use SPI at 10MHz so a 16 bit frame
+    // only takes 1.6us and the DAC can keep up with tens of kHz.
+    spi_init(SPI_PORT, 10*1000*1000);
     gpio_set_function(PIN_MISO, GPIO_FUNC_SPI);
     gpio_set_function(PIN_CS,   GPIO_FUNC_SIO);
     gpio_set_function(PIN_SCK,  GPIO_FUNC_SPI);
@@ -36,58 +36,31 @@ int main()
     gpio_put(PIN_CS, 1);
 
     float v;
-    float f = 2; //Hz
-    float t = 0;
     // For more examples of SPI use see https://github.com/raspberrypi/pico-examples/tree/master/spi
 
-    while (true) {
-        sleep_ms(1);
-        t += 1;
-        if (t > TMAX){
-            t = 0;
-        }
-
-        //sine wave (2Hz):
-        v = VREF/2 * sin(4*(3.14)*f*t) + VREF/2; 
+    // compute one period of the wave up front, the DMA replays it forever
+    for (int i = 0; i < NUM_SAMPLES; i++){
+        //sine wave:
+        v = VREF/2 * sin(2*M_PI*i/NUM_SAMPLES) + VREF/2;
 
-        //Triangle wave (1Hz):
-        // if (t < TMAX/2){
-        //     v = ((float)(t/TMAX) * VREF * 2);
+        //Triangle wave:
+        // if (i < NUM_SAMPLES/2){
+        //     v = ((float)i/NUM_SAMPLES) * VREF * 2;
         // }
-        // else if (t >= TMAX/2){
-        //     v = (2 * VREF * (1-(float)(t/TMAX)));
+        // else {
+        //     v = 2 * VREF * (1-(float)i/NUM_SAMPLES);
         // }
 
-        writeDac(0,v);
+        wave[i] = dac_voltage_frame(0, v, VREF);
     }
-}
-
-//channel is 1 or 0 that represents channel A or B
-void writeDac(int channel, float voltage){
-    uint8_t data[2];
-    uint16_t v = (uint16_t)(voltage * 1024.0 / VREF);
-    int len = 2;
-    data[0] = 0b01110000;
-    data[0] = data[0] | (channel << 7);
-    data[0] = data[0] | (uint8_t)((v >> 6) & 0xF); 
-
-    data[1] = 0b00000000;
-    data[1] = data[1] | (uint8_t)((v << 2) & 0x00FF); 
-    cs_select(PIN_CS);
-    spi_write_blocking(SPI_PORT, data, len);
-    cs_deselect(PIN_CS);
-}
 
-static inline void cs_select(uint cs_pin) {
-    asm volatile("nop \n nop \n nop"); // FIXME
-    gpio_put(cs_pin, 0);
-    asm volatile("nop \n nop \n nop"); // FIXME
-}
+    dac_dma_init(SPI_PORT, PIN_CS);
+    if (!dac_dma_start(wave, NUM_SAMPLES, SAMPLE_RATE)){
+        printf("%d Hz is out of the pacing timer's range\n", SAMPLE_RATE);
+    }
 
-static inline void cs_deselect(uint cs_pin) {
-    asm volatile("nop \n nop \n nop"); // FIXME
-    gpio_put(cs_pin, 1);
-    asm volatile("nop \n nop \n nop"); // FIXME
+    while (true) {
+        // nothing to do per sample, the pacing timer and DMA clock the DAC
+        __wfi();
+    }
 }
-
-
@@ -2,6 +2,15 @@
 #include <math.h>
 #include "pico/stdlib.h"
 #include "hardware/spi.h"
+#include "dac_dma.h"
+#include "spi_ram.h"
+#include "awg.h"
+#include "ram_stream.h"
+#include "spi_bus.h"
+#include "ram_cache.h"
+#include "tlog.h"
+#include "bench.h"
+#include "hardware/adc.h"
 
 // SPI Defines
 // We are going to use SPI 0, and allocate it to the following GPIO pins
@@ -11,28 +20,35 @@
 #define DAC_CS   17
 #define PIN_SCK  18
 #define PIN_MOSI 19
-#define RAM_CS   13
+#define DAC_BAUD (10*1000*1000)
 #define VREF 3.3
+#define SAMPLE_RATE 1000 // Hz, under the DMA timers' floor so dac_dma paces it off PWM
+#define NUM_SAMPLES 1000
+#define LOG_ADC_PIN 26    // ADC0, e.g. looped back from the DAC output
+#define LOG_RATE_HZ 1000
+#define LOG_CHECK_MS 500  // logging at boot before checking it reached the RAM
 
 
-static inline void cs_select(uint cs_pin);
-static inline void cs_deselect(uint cs_pin);
 void writeDac(int channel, float voltage);
-float spi_ram_read(uint16_t address);
-void spi_ram_write(uint16_t addr, float v);
-void spi_ram_init();
 void my_spi_init();
 
-union FloatInt {
-    float f;
-    uint32_t i;
-};
+static uint16_t wave[NUM_SAMPLES]; // DAC codes for the startup waveform
+static spi_device_t dac_dev;
+static repeating_timer_t log_timer;
+
+// sample the ADC into the telemetry log
+static bool log_callback(repeating_timer_t *t){
+    int16_t v = adc_read();
+    tlog_append(TLOG_ADC, &v, 1);
+    return true;
+}
 
 int main()
 {
     stdio_init_all();
     my_spi_init();
     spi_ram_init();
+    ram_cache_init();
 
     volatile float f1, f2;
 
@@ -45,176 +61,95 @@ int main()
 
     printf("\nFloats: %f, %f \n", f1, f2);
 
-    volatile float f_add, f_sub, f_mult, f_div;
-    absolute_time_t start;
-    absolute_time_t stop;
-    uint64_t startms;
-    uint64_t stopms;
+    // cycle counts for the float ops and friends, loop overhead calibrated out
+    bench_init();
+    bench_suite(f1, f2);
 
-    start = get_absolute_time();
-    for (int i = 0; i < 1000 ; i++){
-        f_add = f1+f2;
-    }
-    stop = get_absolute_time();
-
-    uint64_t addTime = to_us_since_boot(stop - start);
-    //printf("%llu \n\r", addTime);
-    int addClocks = (int)(addTime / 6.667);
-    printf("Addition Cycles: %d \n\r", addClocks);
+    //RAM Stuff
+    spi_ram_benchmark(NUM_SAMPLES);
+    ram_cache_benchmark(NUM_SAMPLES);
 
-    start = get_absolute_time();
-    for (int i = 0; i < 1000 ; i++){
-        f_sub = f1-f2;
+    static float samples[NUM_SAMPLES];
+    for (uint16_t i = 0; i < NUM_SAMPLES; i++){
+        //calculate sine
+        samples[i] = VREF/2 * sin(4*(3.14)*i) + VREF/2;
     }
-    stop = get_absolute_time();
-
-    uint64_t subTime = to_us_since_boot(stop - start);
-    int subClocks = (int)(subTime / 6.667);
-    printf("Subtraction Cycles: %d \n\r", subClocks);
 
-    start = get_absolute_time();
-    for (int i = 0; i < 1000 ; i++){
-        f_mult = f1*f2;
+    //write all of them to ram in one burst
+    // pull the samples back out of the RAM once into AWG slot 0 and let the
+    // DMA pacing timer clock them into the DAC. Nothing holds the bus yet, but
+    // if that fails samples[] still has what was computed
+    if (!spi_ram_write_floats(0, samples, NUM_SAMPLES) || !spi_ram_read_floats(0, samples, NUM_SAMPLES)){
+        printf("SPI RAM busy, playing the samples without the round trip\n");
     }
-    stop = get_absolute_time();
-
-    uint64_t multTime = to_us_since_boot(stop - start);
-    int multClocks = (int)(multTime / 6.667);
-    printf("Multiplication Cycles %d \n\r", multClocks);
-
-    start = get_absolute_time();
-    for (int i = 0; i < 1000 ; i++){
-        f_div = f1/f2;
+    for (int i = 0; i < NUM_SAMPLES; i++){
+        wave[i] = (uint16_t)(samples[i] * 1024.0 / VREF);
     }
-    stop = get_absolute_time();
 
-    uint64_t divTime = to_us_since_boot(stop - start);
-    int divClocks = (int)(divTime / 6.667);
-    printf("Division Cycles: %d \n\r", divClocks);
-
-    float v;
-    uint16_t addrCount = 0;
-
-    //RAM Stuff
-    for (uint16_t i = 0; i < 1000; i++){
-        //calculate sine
-        v = VREF/2 * sin(4*(3.14)*i) + VREF/2;
-        //printf("%f\n\r", v);
-
-        //write v to ram
-        spi_ram_write(addrCount, v);
-        addrCount += 4;
+    dac_dma_init(SPI_PORT, DAC_CS);
+    ram_stream_init(SPI_PORT, DAC_CS);
+    awg_init();
+    awg_load(0, wave, NUM_SAMPLES);
+    uint32_t rate = awg_play(0, 0, SAMPLE_RATE, AWG_LOOP, 0);
+    if (rate){
+        printf("playing slot 0 at %lu Hz\n", (unsigned long)rate);
+    }
+    else {
+        printf("can't play slot 0 at %d Hz\n", SAMPLE_RATE);
+    }
+    adc_init();
+    adc_gpio_init(LOG_ADC_PIN);
+    adc_select_input(0);
+    tlog_init();
+    tlog_arm();
+    add_repeating_timer_us(-1000000 / LOG_RATE_HZ, log_callback, NULL, &log_timer);
+
+    // the batches go out between DAC frames, check some made it to the chip
+    absolute_time_t until = make_timeout_time_ms(LOG_CHECK_MS);
+    while (!time_reached(until)){
+        tlog_poll();
+    }
+    tlog_stats_t st;
+    tlog_get_stats(&st);
+    printf("log: %lu appended, %lu written to the RAM in %lu batches, %lu dropped\n",
+           (unsigned long)st.appended, (unsigned long)st.written,
+           (unsigned long)st.batches, (unsigned long)st.dropped);
+    tlog_record_t last;
+    if (st.written && spi_ram_read_block(TLOG_BASE + (st.written - 1) % TLOG_RECORDS * sizeof(tlog_record_t),
+                                         (uint8_t *)&last, sizeof(last))){
+        printf("newest record in the RAM: seq %u at %lu us, ADC %d\n",
+               last.seq, (unsigned long)last.time_us, last.v[0]);
     }
+    printf("AWG ready, type help\n");
 
-    addrCount = 0;
     while (true) {
-        v = spi_ram_read(addrCount);
-        printf("%f at %d\n\r", v, addrCount);
-        writeDac(0, v);
-
-        addrCount += 4;
-
-        if (addrCount > 3999){
-            addrCount = 0;
-        }
-
-        sleep_ms(1);
+        // waveform upload and playback commands from the PC
+        awg_poll();
+        // staged telemetry out to the external RAM
+        tlog_poll();
     }
 
 }
 
-static inline void cs_select(uint cs_pin) {
-    asm volatile("nop \n nop \n nop"); // FIXME
-    gpio_put(cs_pin, 0);
-    asm volatile("nop \n nop \n nop"); // FIXME
-}
-
-static inline void cs_deselect(uint cs_pin) {
-    asm volatile("nop \n nop \n nop"); // FIXME
-    gpio_put(cs_pin, 1);
-    asm volatile("nop \n nop \n nop"); // FIXME
-}
-
 void my_spi_init(){
-    //SPI initialisation. This example will use SPI at 1MHz.
-    spi_init(SPI_PORT, 1000*1000);
+    //SPI initialisation. This example will use SPI at 10MHz, fast enough for
+    //the DAC to take tens of kHz and well inside the 23K256's 20MHz.
+    spi_init(SPI_PORT, 10*1000*1000);
     gpio_set_function(PIN_MISO, GPIO_FUNC_SPI);
-    gpio_set_function(RAM_CS,   GPIO_FUNC_SIO);
-    gpio_set_function(DAC_CS,   GPIO_FUNC_SIO);
     gpio_set_function(PIN_SCK,  GPIO_FUNC_SPI);
     gpio_set_function(PIN_MOSI, GPIO_FUNC_SPI);
-    
-    //Chip select is active-low, so we'll initialise it to a driven-high state
-    gpio_set_dir(RAM_CS, GPIO_OUT);
-    gpio_put(RAM_CS, 1);
 
-    gpio_set_dir(DAC_CS, GPIO_OUT);
-    gpio_put(DAC_CS, 1);
+    //the bus drives each chip select, the DAC takes whole 16 bit frames
+    spi_bus_init(SPI_PORT);
+    spi_bus_add_device(&dac_dev, DAC_CS, DAC_BAUD, 16, SPI_CPOL_0, SPI_CPHA_0);
 }
 
-void spi_ram_init(){
-    uint8_t buf[2];
-    buf[0] = 0b00000001;
-    buf[1] = 0b01000000; // seq mode
-
-    cs_select(RAM_CS);
-    spi_write_blocking(spi_default, buf, 2); 
-    cs_deselect(RAM_CS);   
-}
-
-void spi_ram_write(uint16_t addr, float v){
-    uint8_t buf[7];
-    buf[0] = 0b00000010;
-    buf[1] = (addr>>8)&0xFF;
-    buf[2] = addr&0xFF;
-
-    union FloatInt num;
-    num.f = v;
-
-    buf[3] = (num.i>>24)&0xFF;
-    buf[4] = (num.i>>16)&0xFF;
-    buf[5] = (num.i>>8)&0xFF;
-    buf[6] = num.i&0xFF;
-    
-    cs_select(RAM_CS);
-    spi_write_blocking(spi_default, buf, 7);
-    cs_deselect(RAM_CS);
-
-}
+void writeDac(int channel, float voltage){
+    uint16_t frame = dac_voltage_frame(channel, voltage, VREF);
 
-float spi_ram_read(uint16_t address){
-    uint8_t write[3], read[4];
-    write[0] = 0b00000011;
-    write[1] = (address>>8) & 0xFF;
-    write[2] = address & 0xFF;
-
-    cs_select(RAM_CS);
-    //spi_write_read_blocking(spi_default, write, read, 7);
-    spi_write_blocking(spi_default, write, 3);
-    spi_read_blocking(spi_default, 0x00, read, 4);
-    cs_deselect(RAM_CS);
-
-    union FloatInt num;
-    num.i = ((uint32_t)read[0] << 24) |
-            ((uint32_t)read[1] << 16) |
-            ((uint32_t)read[2] << 8)  |
-            ((uint32_t)read[3]);
-
-    return num.f;
+    spi_xfer_t x = {0};
+    x.dev = &dac_dev;
+    x.tx = &frame;
+    x.len = 1;
+    spi_bus_transfer(&x);
 }
-
-void writeDac(int channel, float voltage){
-    uint8_t data[2];
-    uint16_t v = (uint16_t)(voltage * 1024.0 / VREF);
-    int len = 2;
-    data[0] = 0b01110000;
-    data[0] = data[0] | (channel << 7);
-    data[0] = data[0] | (uint8_t)((v >> 6) & 0xF); 
-
-    data[1] = 0b00000000;
-    data[1] = data[1] | (uint8_t)((v << 2) & 0x00FF); 
-
-    cs_select(DAC_CS);
-    spi_write_blocking(SPI_PORT, data, len);
-    cs_deselect(DAC_CS);
-}
\ No newline at end of file
@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include "awg.h"
+#include "dac_dma.h"
+#include "spi_ram.h"
+#include "ram_stream.h"
+#include "spi_bus.h"
+#include "ram_cache.h"
+#include "tlog.h"
+
+#define LINE_LEN 64
+#define UPLOAD_TIMEOUT_US 1000000 // give up if the PC stops sending for 1s
+
+typedef struct {
+    uint16_t frames[AWG_MAX_SAMPLES]; // ready to send SPI frames
+    uint count;
+    int channel; // channel the frames are currently stamped for
+} awg_slot_t;
+
+static awg_slot_t slots[AWG_NUM_SLOTS];
+static char line[LINE_LEN];
+static int lineLen = 0;
+static awg_mode_t playMode;
+
+static void trigger_callback(uint gpio, uint32_t events){
+    if (gpio == AWG_TRIGGER_PIN && playMode == AWG_TRIGGERED){
+        dac_dma_trigger();
+    }
+}
+
+void awg_init(void){
+    gpio_init(AWG_TRIGGER_PIN);
+    gpio_set_dir(AWG_TRIGGER_PIN, GPIO_IN);
+    gpio_pull_down(AWG_TRIGGER_PIN);
+    gpio_set_irq_enabled_with_callback(AWG_TRIGGER_PIN, GPIO_IRQ_EDGE_RISE, false, &trigger_callback);
+}
+
+static bool valid_slot(int slot){
+    return slot >= 0 && slot < AWG_NUM_SLOTS;
+}
+
+bool awg_load(int slot, const uint16_t *codes, uint count){
+    if (!valid_slot(slot) || count == 0 || count > AWG_MAX_SAMPLES){
+        return false;
+    }
+    awg_stop();
+    for (uint i = 0; i < count; i++){
+        slots[slot].frames[i] = dac_frame(0, codes[i]);
+    }
+    slots[slot].count = count;
+    slots[slot].channel = 0;
+    return true;
+}
+
+uint32_t awg_play(int slot, int channel, uint32_t rate, awg_mode_t mode, uint cycles){
+    if (!valid_slot(slot) || slots[slot].count == 0 || rate == 0){
+        return 0;
+    }
+    awg_stop();
+
+    // restamp the channel bit once here so playback stays free
+    awg_slot_t *s = &slots[slot];
+    channel = channel ? 1 : 0;
+    if (s->channel != channel){
+        for (uint i = 0; i < s->count; i++){
+            s->frames[i] ^= DAC_CHANNEL_BIT;
+        }
+        s->channel = channel;
+    }
+
+    playMode = mode;
+    uint32_t actual;
+    if (mode == AWG_LOOP){
+        actual = dac_dma_start(s->frames, s->count, rate);
+    }
+    else if (mode == AWG_BURST){
+        actual = dac_dma_start_burst(s->frames, s->count, rate, cycles);
+    }
+    else {
+        actual = dac_dma_arm_burst(s->frames, s->count, rate, cycles);
+        if (actual){
+            gpio_set_irq_enabled(AWG_TRIGGER_PIN, GPIO_IRQ_EDGE_RISE, true);
+        }
+    }
+    return actual;
+}
+
+void awg_stop(void){
+    gpio_set_irq_enabled(AWG_TRIGGER_PIN, GPIO_IRQ_EDGE_RISE, false);
+    dac_dma_stop();
+    ram_stream_stop();
+}
+
+// blocking read of raw bytes from the USB serial
+static bool read_bytes(uint8_t *buf, uint len){
+    for (uint i = 0; i < len; i++){
+        int c = getchar_timeout_us(UPLOAD_TIMEOUT_US);
+        if (c == PICO_ERROR_TIMEOUT){
+            return false;
+        }
+        buf[i] = (uint8_t)c;
+    }
+    return true;
+}
+
+static void cmd_upload(int slot, uint count){
+    if (!valid_slot(slot) || count == 0 || count > AWG_MAX_SAMPLES){
+        printf("err bad slot or count\n");
+        return;
+    }
+    awg_stop();
+    printf("ready\n");
+
+    // land the codes in the slot, then convert them to frames in place
+    awg_slot_t *s = &slots[slot];
+    uint8_t *raw = (uint8_t *)s->frames;
+    if (!read_bytes(raw, count * 2)){
+        s->count = 0;
+        printf("err timeout\n");
+        return;
+    }
+    for (uint i = 0; i < count; i++){
+        uint16_t code = raw[2*i] | ((uint16_t)raw[2*i + 1] << 8);
+        s->frames[i] = dac_frame(0, code);
+    }
+    s->count = count;
+    s->channel = 0;
+    printf("ok %d %u\n", slot, count);
+}
+
+// frames go to the external RAM as raw bytes in one burst, below the
+// telemetry log which has the top of it
+static void cmd_save(int slot, uint addr){
+    if (!valid_slot(slot) || slots[slot].count == 0 || addr + slots[slot].count * 2 > TLOG_BASE){
+        printf("err bad slot or address\n");
+        return;
+    }
+    awg_stop(); // the RAM needs the bus back
+    awg_slot_t *s = &slots[slot];
+    if (!spi_ram_write_block(addr, (const uint8_t *)s->frames, s->count * 2)){
+        printf("err bus busy\n");
+        return;
+    }
+    printf("ok %d %u\n", slot, s->count);
+}
+
+static void cmd_load(int slot, uint addr, uint count){
+    if (!valid_slot(slot) || count == 0 || count > AWG_MAX_SAMPLES || addr + count * 2 > TLOG_BASE){
+        printf("err bad slot, address or count\n");
+        return;
+    }
+    awg_stop();
+    awg_slot_t *s = &slots[slot];
+    if (!spi_ram_read_block(addr, (uint8_t *)s->frames, count * 2)){
+        // some of it may have landed, don't play half a waveform
+        s->count = 0;
+        printf("err bus busy, slot %d cleared\n", slot);
+        return;
+    }
+    s->count = count;
+    s->channel = (s->frames[0] & DAC_CHANNEL_BIT) ? 1 : 0;
+    printf("ok %d %u\n", slot, count);
+}
+
+static void cmd_stream(uint addr, uint count, uint32_t rate){
+    if (count == 0 || addr + count * 2 > SPI_RAM_SIZE){
+        printf("err bad address or count\n");
+        return;
+    }
+    awg_stop();
+    uint32_t actual = ram_stream_start(addr, count, rate);
+    if (actual == 0){
+        printf("err rate out of reach, too high to refill from the RAM, or the bus is busy\n");
+        return;
+    }
+    ram_stream_stats_t st;
+    ram_stream_get_stats(&st);
+    printf("ok %lu Hz, %u frame blocks in %u frame slices\n", (unsigned long)actual,
+           st.block_len, st.slice_len);
+}
+
+static void cmd_stats(void){
+    ram_stream_stats_t st;
+    ram_stream_get_stats(&st);
+    printf("stream %s: block %u, slice %u, blocks %lu, late %lu, max gap %lu us\n",
+           ram_stream_running() ? "running" : "stopped", st.block_len, st.slice_len,
+           (unsigned long)st.blocks, (unsigned long)st.late, (unsigned long)st.max_gap_us);
+    printf("ok\n");
+}
+
+static void cmd_bus(void){
+    spi_bus_stats_t st;
+    spi_bus_get_stats(&st);
+    uint util = spi_bus_utilisation(&st);
+    printf("bus: %lu submitted, %lu completed, depth %u (max %u), %lu claims, %lu lent, %u.%u%% busy\n",
+           (unsigned long)st.submitted, (unsigned long)st.completed, st.depth, st.max_depth,
+           (unsigned long)st.claims, (unsigned long)st.lends, util / 10, util % 10);
+    spi_bus_reset_stats();
+    printf("ok\n");
+}
+
+static void cmd_cache(uint n){
+    awg_stop(); // the benchmark needs the bus
+    ram_cache_benchmark(n);
+    printf("ok\n");
+}
+
+static void cmd_log(char *args){
+    unsigned post;
+    if (strcmp(args, "arm") == 0){
+        tlog_arm();
+    }
+    else if (sscanf(args, "trig %u", &post) == 1){
+        tlog_trigger(post);
+    }
+    else if (strcmp(args, "stats") == 0){
+        tlog_stats_t st;
+        tlog_get_stats(&st);
+        printf("log %s: %lu appended, %lu dropped, %lu written in %lu batches, max staged %u\n",
+               tlog_frozen() ? "frozen" : "recording", (unsigned long)st.appended,
+               (unsigned long)st.dropped, (unsigned long)st.written,
+               (unsigned long)st.batches, st.max_staged);
+    }
+    else if (strcmp(args, "dump") == 0){
+        awg_stop(); // the log needs the bus to drain and read back
+        if (!tlog_dump()){
+            printf("err log not armed\n");
+            return;
+        }
+    }
+    else {
+        printf("err usage: log arm|trig <n>|stats|dump\n");
+        return;
+    }
+    printf("ok\n");
+}
+
+static void cmd_play(char *args){
+    int slot, channel;
+    unsigned long rate;
+    char mode[8] = "loop";
+    unsigned cycles = 1;
+    int n = sscanf(args, "%d %d %lu %7s %u", &slot, &channel, &rate, mode, &cycles);
+    if (n < 3){
+        printf("err usage: play <slot> <ch> <rate> [loop|burst <n>|trig <n>]\n");
+        return;
+    }
+
+    awg_mode_t m;
+    if (strcmp(mode, "loop") == 0){
+        m = AWG_LOOP;
+    }
+    else if (strcmp(mode, "burst") == 0){
+        m = AWG_BURST;
+    }
+    else if (strcmp(mode, "trig") == 0){
+        m = AWG_TRIGGERED;
+    }
+    else {
+        printf("err unknown mode %s\n", mode);
+        return;
+    }
+
+    uint32_t actual = awg_play(slot, channel, rate, m, cycles);
+    if (!actual){
+        printf("err bad slot or rate\n");
+        return;
+    }
+    printf("ok %lu Hz\n", (unsigned long)actual);
+}
+
+static void handle_line(char *cmd){
+    char *args = cmd;
+    while (*args && *args != ' '){
+        args++;
+    }
+    if (*args){
+        *args++ = '\0';
+    }
+
+    int slot;
+    unsigned addr, count;
+    unsigned long rate;
+    if (strcmp(cmd, "upload") == 0 && sscanf(args, "%d %u", &slot, &count) == 2){
+        cmd_upload(slot, count);
+    }
+    else if (strcmp(cmd, "play") == 0){
+        cmd_play(args);
+    }
+    else if (strcmp(cmd, "stop") == 0){
+        awg_stop();
+        printf("ok\n");
+    }
+    else if (strcmp(cmd, "save") == 0 && sscanf(args, "%d %u", &slot, &addr) == 2){
+        cmd_save(slot, addr);
+    }
+    else if (strcmp(cmd, "load") == 0 && sscanf(args, "%d %u %u", &slot, &addr, &count) == 3){
+        cmd_load(slot, addr, count);
+    }
+    else if (strcmp(cmd, "stream") == 0 && sscanf(args, "%u %u %lu", &addr, &count, &rate) == 3){
+        cmd_stream(addr, count, rate);
+    }
+    else if (strcmp(cmd, "stats") == 0){
+        cmd_stats();
+    }
+    else if (strcmp(cmd, "bus") == 0){
+        cmd_bus();
+    }
+    else if (strcmp(cmd, "cache") == 0 && sscanf(args, "%u", &count) == 1){
+        cmd_cache(count);
+    }
+    else if (strcmp(cmd, "log") == 0){
+        cmd_log(args);
+    }
+    else if (strcmp(cmd, "list") == 0){
+        for (int i = 0; i < AWG_NUM_SLOTS; i++){
+            printf("slot %d: %u samples, channel %d\n", i, slots[i].count, slots[i].channel);
+        }
+        printf("ok\n");
+    }
+    else if (strcmp(cmd, "help") == 0){
+        printf("upload <slot> <count> | play <slot> <ch> <rate> [loop|burst <n>|trig <n>] | stop\n");
+        printf("save <slot> <addr> | load <slot> <addr> <count> | list\n");
+        printf("stream <addr> <count> <rate> | stats | bus | cache <n>\n");
+        printf("log arm | log trig <n> | log stats | log dump\n");
+        printf("ok\n");
+    }
+    else if (cmd[0] != '\0'){
+        printf("err unknown command %s\n", cmd);
+    }
+}
+
+void awg_poll(void){
+    int c;
+    while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT){
+        if (c == '\n'){
+            line[lineLen] = '\0';
+            lineLen = 0;
+            handle_line(line);
+        }
+        else if (c != '\r' && lineLen < LINE_LEN - 1){
+            line[lineLen++] = (char)c;
+        }
+    }
+}
@@ -0,0 +1,46 @@
+#ifndef AWG_H__
+#define AWG_H__
+
+#include "pico/stdlib.h"
+
+// Arbitrary waveform generator on top of dac_dma.
+// Tables are uploaded over USB as raw 10 bit DAC codes, converted once into
+// SPI frames and kept in RAM slots, and can be stashed in the 23K256.
+//
+// Commands, one per line:
+//   upload <slot> <count>          then count little endian uint16 codes
+//   play <slot> <ch> <rate> [loop | burst <n> | trig <n>]
+//   stop
+//   save <slot> <addr>             copy a slot into the external RAM, below TLOG_BASE
+//   load <slot> <addr> <count>     copy count samples from the external RAM, below TLOG_BASE
+//   stream <addr> <count> <rate>   loop count saved frames straight out of the external RAM
+//   stats                          streaming block and slice size, late fetches
+//   bus                            SPI bus queue depth and utilisation since the last bus
+//   cache <n>                      page cache benchmark, overwrites the external RAM below the log
+//   log arm                        clear the telemetry log and start recording
+//   log trig <n>                   freeze the log n records from now
+//   log stats
+//   log dump                       stops playback, then the binary log (see tlog.h)
+//   list
+//   help
+
+#define AWG_NUM_SLOTS   4
+#define AWG_MAX_SAMPLES 4096
+#define AWG_TRIGGER_PIN 14 // rising edge starts a triggered burst
+
+typedef enum {
+    AWG_LOOP,
+    AWG_BURST,
+    AWG_TRIGGERED
+} awg_mode_t;
+
+void awg_init(void);
+// fill a slot with count codes (0-1023), returns false if it doesn't fit
+bool awg_load(int slot, const uint16_t *codes, uint count);
+// returns the sample rate actually set, 0 for a bad slot or a rate out of reach
+uint32_t awg_play(int slot, int channel, uint32_t rate, awg_mode_t mode, uint cycles);
+void awg_stop(void);
+// handle any pending input from the PC, call this from the main loop
+void awg_poll(void);
+
+#endif
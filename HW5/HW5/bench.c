@@ -0,0 +1,227 @@
+#if !PICO_ON_DEVICE
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "bench.h"
+
+#if PICO_ON_DEVICE
+#include "pico/stdlib.h"
+#include "pico/float.h"
+#include "hardware/sync.h"
+#include "hardware/structs/systick.h"
+#else
+#include <time.h>
+#endif
+
+#define OP_ITERS   1000
+#define COPY_ITERS 100
+
+void bench_init(void){
+#if PICO_ON_DEVICE
+    // free running 24 bit down counter on the processor clock
+    systick_hw->csr = 0;
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x5; // enable, processor clock, no interrupt
+#endif
+}
+
+uint32_t bench_now(void){
+#if PICO_ON_DEVICE
+    return systick_hw->cvr;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000000000ull + ts.tv_nsec);
+#endif
+}
+
+static void empty(uint32_t n){
+    for (uint32_t i = 0; i < n; i++){
+        __asm volatile("" ::: "memory");
+    }
+}
+
+// one timed call, interrupts off on the Pico so nothing else lands in the window
+static uint32_t time_once(bench_fn_t fn, uint32_t iters){
+#if PICO_ON_DEVICE
+    uint32_t save = save_and_disable_interrupts();
+    uint32_t t0 = bench_now();
+    fn(iters);
+    uint32_t t1 = bench_now();
+    restore_interrupts(save);
+    return (t0 - t1) & 0x00FFFFFF; // counts down and wraps at 24 bits
+#else
+    uint32_t t0 = bench_now();
+    fn(iters);
+    uint32_t t1 = bench_now();
+    return t1 - t0;
+#endif
+}
+
+bench_result_t bench_run(bench_fn_t fn, bench_fn_t base, uint32_t iters){
+    if (!base){
+        base = empty;
+    }
+
+    // kernel and baseline back to back each run so any drift hits both
+    uint32_t runs[BENCH_RUNS];
+    for (int i = 0; i < BENCH_RUNS; i++){
+        int64_t t = (int64_t)time_once(fn, iters) - time_once(base, iters);
+        if (t < 0){
+            t = 0;
+        }
+        runs[i] = (uint32_t)(t * 100 / iters);
+    }
+
+    // insertion sort, there are only a handful
+    for (int i = 1; i < BENCH_RUNS; i++){
+        uint32_t v = runs[i];
+        int j = i - 1;
+        while (j >= 0 && runs[j] > v){
+            runs[j + 1] = runs[j];
+            j--;
+        }
+        runs[j + 1] = v;
+    }
+
+    bench_result_t r;
+    r.min = runs[0];
+    r.median = runs[BENCH_RUNS / 2];
+    r.max = runs[BENCH_RUNS - 1];
+    return r;
+}
+
+void bench_print_header(void){
+    printf("%-16s %10s %10s %10s  (%s per op)\n", "", "min", "median", "max", BENCH_UNIT);
+}
+
+void bench_print(const char *name, const bench_result_t *r){
+    printf("%-16s %7lu.%02lu %7lu.%02lu %7lu.%02lu\n", name,
+           (unsigned long)(r->min / 100), (unsigned long)(r->min % 100),
+           (unsigned long)(r->median / 100), (unsigned long)(r->median % 100),
+           (unsigned long)(r->max / 100), (unsigned long)(r->max % 100));
+}
+
+// operands come from volatiles so nothing gets folded at compile time, and every
+// kernel stores to a volatile result so nothing gets dropped
+static volatile float fa, fb;
+static volatile double da, db;
+static volatile int32_t qa, qb; // Q16.16
+
+#define KERNEL(name, type, body)            \
+    static void name(uint32_t n){           \
+        volatile type r;                    \
+        for (uint32_t i = 0; i < n; i++){   \
+            body;                           \
+        }                                   \
+        (void)r;                            \
+    }
+
+// baselines: the same loads and store without the operation
+KERNEL(float_base, float, (void)fb; r = fa)
+KERNEL(double_base, double, (void)db; r = da)
+KERNEL(fixed_base, int32_t, (void)qb; r = qa)
+KERNEL(to_fix_base, int32_t, (void)fa; r = qa)
+KERNEL(to_float_base, float, (void)qa; r = fa)
+
+KERNEL(float_add, float, r = fa + fb)
+KERNEL(float_sub, float, r = fa - fb)
+KERNEL(float_mul, float, r = fa * fb)
+KERNEL(float_div, float, r = fa / fb)
+KERNEL(float_sqrt, float, (void)fb; r = sqrtf(fa))
+KERNEL(float_sin, float, (void)fb; r = sinf(fa))
+
+KERNEL(double_add, double, r = da + db)
+KERNEL(double_mul, double, r = da * db)
+KERNEL(double_div, double, r = da / db)
+
+KERNEL(fixed_add, int32_t, r = qa + qb)
+KERNEL(fixed_mul, int32_t, r = (int32_t)(((int64_t)qa * qb) >> 16))
+KERNEL(fixed_div, int32_t, r = (int32_t)(((int64_t)qa << 16) / qb))
+
+KERNEL(cast_to_fix, int32_t, r = (int32_t)(fa * 65536.0f))
+KERNEL(cast_to_float, float, r = qa / 65536.0f)
+#if PICO_ON_DEVICE
+KERNEL(sdk_float2fix, int32_t, r = float2fix(fa, 16))
+KERNEL(sdk_fix2float, float, r = fix2float(qa, 16))
+#endif
+
+static uint8_t copy_src[1024];
+static uint8_t copy_dst[1024];
+
+#define COPY_KERNEL(name, len)                          \
+    static void name(uint32_t n){                       \
+        for (uint32_t i = 0; i < n; i++){               \
+            memcpy(copy_dst, copy_src, len);            \
+            __asm volatile("" ::: "memory");            \
+        }                                               \
+    }
+
+COPY_KERNEL(copy_16, 16)
+COPY_KERNEL(copy_64, 64)
+COPY_KERNEL(copy_1k, 1024)
+
+typedef struct {
+    const char *name;
+    bench_fn_t fn;
+    bench_fn_t base;
+    uint32_t iters;
+} bench_case_t;
+
+static const bench_case_t suite[] = {
+    {"float add",     float_add,     float_base,    OP_ITERS},
+    {"float sub",     float_sub,     float_base,    OP_ITERS},
+    {"float mul",     float_mul,     float_base,    OP_ITERS},
+    {"float div",     float_div,     float_base,    OP_ITERS},
+    {"sqrtf",         float_sqrt,    float_base,    OP_ITERS},
+    {"sinf",          float_sin,     float_base,    OP_ITERS},
+    {"double add",    double_add,    double_base,   OP_ITERS},
+    {"double mul",    double_mul,    double_base,   OP_ITERS},
+    {"double div",    double_div,    double_base,   OP_ITERS},
+    {"q16 add",       fixed_add,     fixed_base,    OP_ITERS},
+    {"q16 mul",       fixed_mul,     fixed_base,    OP_ITERS},
+    {"q16 div",       fixed_div,     fixed_base,    OP_ITERS},
+    {"float->q16",    cast_to_fix,   to_fix_base,   OP_ITERS},
+    {"q16->float",    cast_to_float, to_float_base, OP_ITERS},
+#if PICO_ON_DEVICE
+    {"float2fix",     sdk_float2fix, to_fix_base,   OP_ITERS},
+    {"fix2float",     sdk_fix2float, to_float_base, OP_ITERS},
+#endif
+    {"memcpy 16B",    copy_16,       NULL,          COPY_ITERS},
+    {"memcpy 64B",    copy_64,       NULL,          COPY_ITERS},
+    {"memcpy 1KB",    copy_1k,       NULL,          COPY_ITERS},
+};
+
+void bench_suite(float a, float b){
+    fa = a;
+    fb = b;
+    da = a;
+    db = b;
+    qa = (int32_t)(a * 65536.0f);
+    qb = (int32_t)(b * 65536.0f);
+    if (qb == 0){
+        qb = 1;
+    }
+
+    printf("Benchmarks with a = %f, b = %f, %d runs each\n", a, b, BENCH_RUNS);
+    bench_print_header();
+    for (size_t i = 0; i < sizeof(suite) / sizeof(suite[0]); i++){
+        bench_result_t r = bench_run(suite[i].fn, suite[i].base, suite[i].iters);
+        bench_print(suite[i].name, &r);
+    }
+}
+
+#if !PICO_ON_DEVICE
+int main(int argc, char **argv){
+    float a = argc > 2 ? strtof(argv[1], NULL) : 1.5f;
+    float b = argc > 2 ? strtof(argv[2], NULL) : 2.25f;
+    bench_init();
+    bench_suite(a, b);
+    return 0;
+}
+#endif
@@ -0,0 +1,46 @@
+#ifndef BENCH_H__
+#define BENCH_H__
+
+#include <stdint.h>
+
+// Micro-benchmark harness.
+// On the Pico each run is timed in CPU cycles with the SysTick counter, with
+// interrupts off. A run is a kernel called with an iteration count; the same loop
+// with a baseline body (the operand loads and result store, no operation) is timed
+// too and subtracted, so the numbers are the cost of the operation alone. Each
+// kernel runs BENCH_RUNS times and reports min/median/max per operation.
+//
+// The file also builds on a PC for the same kernels, timed in ns instead:
+//   gcc -O2 -o bench bench.c -lm && ./bench 1.5 2.25
+
+#define BENCH_RUNS 15
+
+#if PICO_ON_DEVICE
+#define BENCH_UNIT "cycles"
+#else
+#define BENCH_UNIT "ns"
+#endif
+
+typedef void (*bench_fn_t)(uint32_t iters);
+
+// per operation, in hundredths of a BENCH_UNIT
+typedef struct {
+    uint32_t min;
+    uint32_t median;
+    uint32_t max;
+} bench_result_t;
+
+// start the cycle counter, call once before bench_run
+void bench_init(void);
+// raw counter, only differences of nearby readings mean anything
+uint32_t bench_now(void);
+// time fn against base (NULL for an empty loop), iters per run
+bench_result_t bench_run(bench_fn_t fn, bench_fn_t base, uint32_t iters);
+
+void bench_print_header(void);
+void bench_print(const char *name, const bench_result_t *r);
+
+// float, double, fixed point, SDK float helpers and memcpy, operands a and b
+void bench_suite(float a, float b);
+
+#endif
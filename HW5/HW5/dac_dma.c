@@ -0,0 +1,379 @@
+#include "dac_dma.h"
+#include "hardware/dma.h"
+#include "hardware/clocks.h"
+#include "hardware/pwm.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "spi_bus.h"
+
+#define IRQ_BUDGET_US 4 // drain IRQ and parking chip select before a lent gap
+
+static spi_inst_t *dac_spi;
+static uint dac_cs;
+
+// data channel streams frames into the SPI FIFO, one per pacing timer tick.
+// when it runs out it chains to the control channel, which writes the start of
+// the buffer back into the data channel's read address trigger to loop.
+// for a burst the control channel walks a list of buffer pointers instead, and
+// the NULL at the end is a null trigger that leaves the data channel stopped.
+static int data_chan;
+static int ctrl_chan;
+static int pace_timer;
+static bool pace_pwm; // running off DAC_PACE_PWM_SLICE rather than the timer
+static dma_channel_config data_config;
+static const uint16_t *loop_start;
+static const uint16_t *burst_list[DAC_MAX_BURST];
+static const uint16_t *burst_frames;
+static uint burst_count;
+static volatile bool running = false;
+
+// lending the bus: with a transfer waiting, the drain channel catches the end of
+// the next frame and the gap up to the following one goes to the bus. The data
+// channel is paused for the gap, so if the IRQ ran late and the lent transfer
+// overruns the next tick, that frame goes out late instead of into the transfer
+static int drain_chan;
+static uint32_t sink;
+static uint32_t gap_us;        // what can be lent after a frame at this rate
+static volatile bool draining = false;
+static volatile bool paused = false;
+static volatile bool trigger_pending = false; // a trigger came during a lent gap
+
+static void dma_handler();
+
+void dac_dma_init(spi_inst_t *spi, uint cs_pin){
+    dac_spi = spi;
+    dac_cs = cs_pin;
+    data_chan = dma_claim_unused_channel(true);
+    ctrl_chan = dma_claim_unused_channel(true);
+    pace_timer = dma_claim_unused_timer(true);
+    drain_chan = dma_claim_unused_channel(true);
+
+    dma_channel_config c = dma_channel_get_default_config(drain_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, spi_get_dreq(spi, false));
+    dma_channel_configure(drain_chan, &c, &sink, &spi_get_hw(spi)->dr, 0, false);
+    dma_channel_set_irq0_enabled(drain_chan, true);
+    irq_add_shared_handler(DMA_IRQ_0, dma_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+uint16_t dac_frame(int channel, uint16_t code){
+    if (code > DAC_MAX_CODE){
+        code = DAC_MAX_CODE;
+    }
+    uint16_t frame = DAC_CONFIG_BITS | (code << 2);
+    if (channel){
+        frame |= DAC_CHANNEL_BIT;
+    }
+    return frame;
+}
+
+uint16_t dac_voltage_frame(int channel, float voltage, float vref){
+    if (voltage < 0){
+        voltage = 0;
+    }
+    return dac_frame(channel, (uint16_t)(voltage * 1024.0f / vref));
+}
+
+uint32_t dac_pace_timer_min(void){
+    uint64_t clk = clock_get_hz(clk_sys);
+    return (uint32_t)((clk + 0xFFFE) / 0xFFFF);
+}
+
+// the pacing timer ticks at clk_sys * num / den, find the closest 16 bit fraction
+uint32_t dac_pace_timer_set(uint timer, uint32_t sample_rate){
+    uint64_t clk = clock_get_hz(clk_sys);
+    if (sample_rate < dac_pace_timer_min() || sample_rate > clk){
+        return 0;
+    }
+    uint32_t best_num = 1;
+    uint32_t best_den = 0xFFFF;
+    uint64_t best_err = UINT64_MAX;
+
+    for (uint32_t num = 1; num <= 0xFFFF; num++){
+        uint64_t den = (clk * num + sample_rate / 2) / sample_rate;
+        if (den > 0xFFFF){
+            break;
+        }
+        if (den < num){
+            continue;
+        }
+        // compare |clk*num/den - rate| without dividing
+        uint64_t target = (uint64_t)sample_rate * den;
+        uint64_t err = clk * num > target ? clk * num - target : target - clk * num;
+        if (best_err == UINT64_MAX || err * best_den < best_err * den){
+            best_err = err;
+            best_num = num;
+            best_den = den;
+        }
+        if (err == 0){
+            break;
+        }
+    }
+
+    dma_timer_set_fraction(timer, best_num, best_den);
+    return (uint32_t)(clk * best_num / best_den);
+}
+
+// too slow for a timer, pace off a PWM slice wrapping every div * top system
+// clocks instead. Same sums as pwm_solver.h: the smallest 8.4 divider that
+// fits the period in 16 bits, then the closest wrap
+static uint32_t pace_pwm_set(uint32_t sample_rate){
+    uint64_t clk = clock_get_hz(clk_sys);
+    uint64_t ticks16 = (clk * 16 + sample_rate / 2) / sample_rate;
+    uint64_t div16 = ticks16 <= 65536ull * 16 ? 16 : (ticks16 + 65535) / 65536;
+    if (div16 > 255 * 16 + 15){
+        return 0;
+    }
+    uint64_t top = (ticks16 + div16 / 2) / div16;
+
+    pwm_set_enabled(DAC_PACE_PWM_SLICE, false);
+    pwm_set_clkdiv_int_frac(DAC_PACE_PWM_SLICE, div16 / 16, div16 % 16);
+    pwm_set_wrap(DAC_PACE_PWM_SLICE, top - 1);
+    pwm_set_counter(DAC_PACE_PWM_SLICE, 0);
+    return (uint32_t)(clk * 16 / (div16 * top));
+}
+
+// a paused channel keeps its place and ignores its DREQ until it's enabled again
+static void pause_data(bool pause){
+    paused = pause;
+    if (pause){
+        hw_clear_bits(&dma_hw->ch[data_chan].al1_ctrl, DMA_CH0_CTRL_TRIG_EN_BITS);
+    }
+    else {
+        hw_set_bits(&dma_hw->ch[data_chan].al1_ctrl, DMA_CH0_CTRL_TRIG_EN_BITS);
+    }
+}
+
+// back from a lent gap, the next frame needs the bus set up for the DAC again
+static void resume(void){
+    if (!running){
+        return;
+    }
+    spi_set_format(dac_spi, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    gpio_set_function(dac_cs, GPIO_FUNC_SPI);
+    if (paused){
+        pause_data(false);
+    }
+    if (trigger_pending){
+        trigger_pending = false;
+        dac_dma_trigger();
+    }
+}
+
+// park chip select high so the DAC ignores the other device, then lend
+static void lend(uint32_t us){
+    gpio_set_function(dac_cs, GPIO_FUNC_SIO);
+    if (!spi_bus_lend(us, resume)){
+        gpio_set_function(dac_cs, GPIO_FUNC_SPI);
+        if (paused){
+            pause_data(false);
+        }
+    }
+}
+
+// the bus has a transfer waiting. With nothing left to play it can go now,
+// otherwise catch the end of the next frame
+static void want_gap(void){
+    uint32_t save = save_and_disable_interrupts();
+    if (running && !spi_bus_lending()){
+        if (!dac_dma_busy() && !spi_is_busy(dac_spi)){
+            if (draining){
+                dma_channel_abort(drain_chan);
+                dma_channel_acknowledge_irq0(drain_chan);
+                draining = false;
+            }
+            lend(UINT32_MAX);
+        }
+        else if (!draining){
+            // nobody reads what comes back under the DAC frames, start from empty
+            while (spi_is_readable(dac_spi)){
+                (void)spi_get_hw(dac_spi)->dr;
+            }
+            draining = true;
+            dma_channel_transfer_to_buffer_now(drain_chan, &sink, 1);
+        }
+    }
+    restore_interrupts(save);
+}
+
+static void dma_handler(){
+    if (!dma_channel_get_irq0_status(drain_chan)){
+        return;
+    }
+    dma_channel_acknowledge_irq0(drain_chan);
+    draining = false;
+    if (!running){
+        return;
+    }
+    // between frames, hold the data channel first so no tick can slip a frame in
+    // after the check below
+    bool between = dac_dma_busy();
+    if (between){
+        pause_data(true);
+    }
+    if (spi_is_busy(dac_spi)){
+        // the next tick came before we got here, wait for that frame instead
+        if (between){
+            pause_data(false);
+        }
+        want_gap();
+        return;
+    }
+    lend(between ? gap_us : UINT32_MAX);
+}
+
+// set up both channels, the control channel reads from ctrl_read (stepping through
+// it if step is set) every time the data channel finishes the buffer
+static uint32_t configure(const uint16_t *frames, uint count, uint32_t sample_rate,
+                          const volatile void *ctrl_read, bool step){
+    if (running){
+        dac_dma_stop();
+    }
+
+    uint32_t rate = dac_pace_timer_set(pace_timer, sample_rate);
+    uint dreq = dma_get_timer_dreq(pace_timer);
+    pace_pwm = rate == 0;
+    if (pace_pwm){
+        rate = pace_pwm_set(sample_rate);
+        dreq = pwm_get_dreq(DAC_PACE_PWM_SLICE);
+    }
+    if (rate == 0){
+        return 0;
+    }
+
+    // 3/4 of the time between frames can go to other devices on the bus
+    uint32_t frame_us = 16 * 1000000 / spi_get_baudrate(dac_spi) + 1;
+    int32_t spare = (int32_t)(750000 / rate) - IRQ_BUDGET_US - (int32_t)frame_us;
+    gap_us = spare > 0 ? spare : 0;
+    spi_bus_claim(want_gap, gap_us); // the pacing timer owns the bus until dac_dma_stop
+
+    // 16 bit frames with CPHA 0 make the SPI block pulse CSn between frames,
+    // which is exactly the rising edge the MCP4912 latches on
+    spi_set_format(dac_spi, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    gpio_set_function(dac_cs, GPIO_FUNC_SPI);
+
+    data_config = dma_channel_get_default_config(data_chan);
+    channel_config_set_transfer_data_size(&data_config, DMA_SIZE_16);
+    channel_config_set_read_increment(&data_config, true);
+    channel_config_set_write_increment(&data_config, false);
+    channel_config_set_dreq(&data_config, dreq);
+    channel_config_set_chain_to(&data_config, ctrl_chan);
+    dma_channel_configure(data_chan, &data_config,
+                          &spi_get_hw(dac_spi)->dr,
+                          frames,
+                          count,
+                          false);
+
+    dma_channel_config ctrl_config = dma_channel_get_default_config(ctrl_chan);
+    channel_config_set_transfer_data_size(&ctrl_config, DMA_SIZE_32);
+    channel_config_set_read_increment(&ctrl_config, step);
+    channel_config_set_write_increment(&ctrl_config, false);
+    dma_channel_configure(ctrl_chan, &ctrl_config,
+                          &dma_hw->ch[data_chan].al3_read_addr_trig,
+                          ctrl_read,
+                          1,
+                          false);
+
+    running = true;
+    if (pace_pwm){
+        pwm_set_enabled(DAC_PACE_PWM_SLICE, true);
+    }
+    return rate;
+}
+
+uint32_t dac_dma_start(const uint16_t *frames, uint count, uint32_t sample_rate){
+    loop_start = frames;
+    uint32_t rate = configure(frames, count, sample_rate, &loop_start, false);
+    if (rate){
+        dma_channel_start(data_chan);
+        if (spi_bus_waiting()){
+            want_gap();
+        }
+    }
+    return rate;
+}
+
+uint32_t dac_dma_arm_burst(const uint16_t *frames, uint count, uint32_t sample_rate, uint cycles){
+    if (cycles < 1){
+        cycles = 1;
+    }
+    if (cycles > DAC_MAX_BURST){
+        cycles = DAC_MAX_BURST;
+    }
+    // the data channel plays the first pass itself, the list covers the rest
+    for (uint i = 0; i < cycles - 1; i++){
+        burst_list[i] = frames;
+    }
+    burst_list[cycles - 1] = NULL;
+    burst_frames = frames;
+    burst_count = count;
+    uint32_t rate = configure(frames, count, sample_rate, burst_list, true);
+    if (rate && spi_bus_waiting()){
+        want_gap(); // nothing plays until the trigger, lend the bus now
+    }
+    return rate;
+}
+
+uint32_t dac_dma_start_burst(const uint16_t *frames, uint count, uint32_t sample_rate, uint cycles){
+    uint32_t rate = dac_dma_arm_burst(frames, count, sample_rate, cycles);
+    if (rate){
+        dac_dma_trigger();
+    }
+    return rate;
+}
+
+void dac_dma_trigger(void){
+    if (!running || dac_dma_busy()){
+        return;
+    }
+    if (spi_bus_lending()){
+        // the DAC gets the bus back first
+        trigger_pending = true;
+        return;
+    }
+    // rewind the pointer list, then kick the data channel from the top of the buffer
+    dma_channel_set_read_addr(ctrl_chan, burst_list, false);
+    dma_channel_transfer_from_buffer_now(data_chan, burst_frames, burst_count);
+}
+
+void dac_dma_stop(void){
+    if (!running){
+        return;
+    }
+    running = false; // a lent gap ending now leaves the bus alone
+    trigger_pending = false;
+    paused = false; // setting the config below enables the channel again
+    // chaining to itself disables the chain, so the loop can't restart under us
+    channel_config_set_chain_to(&data_config, data_chan);
+    dma_channel_set_config(data_chan, &data_config, false);
+    dma_channel_abort(ctrl_chan);
+    dma_channel_abort(data_chan);
+    if (pace_pwm){
+        pwm_set_enabled(DAC_PACE_PWM_SLICE, false);
+    }
+    dma_channel_abort(drain_chan);
+    dma_channel_acknowledge_irq0(drain_chan);
+    draining = false;
+
+    while (spi_bus_lending() || spi_is_busy(dac_spi)){
+        tight_loop_contents();
+    }
+
+    // hand chip select back to software (driven high) and go back to byte frames
+    gpio_put(dac_cs, 1);
+    gpio_set_dir(dac_cs, GPIO_OUT);
+    gpio_set_function(dac_cs, GPIO_FUNC_SIO);
+    spi_set_format(dac_spi, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    spi_bus_release();
+}
+
+bool dac_dma_running(void){
+    return running;
+}
+
+bool dac_dma_busy(void){
+    return running && (dma_channel_is_busy(data_chan) || dma_channel_is_busy(ctrl_chan));
+}
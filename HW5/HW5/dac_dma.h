@@ -0,0 +1,56 @@
+#ifndef DAC_DMA_H__
+#define DAC_DMA_H__
+
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+
+// MCP4912 16 bit command word:
+// bit 15 channel (0 = A, 1 = B), bit 14 BUF, bit 13 GA (1 = 1x), bit 12 SHDN (1 = active)
+// bits 11-2 are the 10 bit value, bits 1-0 are ignored
+#define DAC_CONFIG_BITS 0x7000
+#define DAC_CHANNEL_BIT 0x8000
+#define DAC_MAX_CODE    1023
+#define DAC_MAX_BURST   64 // most repeats of a buffer in one burst
+#define DAC_PACE_PWM_SLICE 2 // paces rates below the DMA timers' floor, no pin is routed to it
+
+// Output path that streams preformatted frames from a buffer into the SPI TX FIFO.
+// A DMA pacing timer sets the sample clock and the SPI block drives chip select
+// in hardware (16 bit frames, CPHA 0 pulses CSn between every frame), so the CPU
+// does nothing per sample.
+//
+// A DMA timer's 16 bit fraction can't go below clk_sys / 65535 (~2.3kHz at
+// 150MHz); slower rates wrap a PWM slice instead, which reaches ~9Hz. Every
+// start returns the rate actually set, or 0 (and plays nothing) if it's out of
+// reach.
+//
+// While it plays, the DAC holds the SPI bus but lends it out: with a transfer
+// queued for another device, the end of the next frame raises an IRQ and the
+// gap to the frame after goes to that transfer if it fits in 3/4 of a sample
+// period. Stopped bursts and armed triggers lend it for as long as it takes.
+
+void dac_dma_init(spi_inst_t *spi, uint cs_pin);
+
+// build a ready to send SPI frame
+uint16_t dac_frame(int channel, uint16_t code);
+uint16_t dac_voltage_frame(int channel, float voltage, float vref);
+
+// slowest rate a DMA pacing timer can tick at
+uint32_t dac_pace_timer_min(void);
+// point a DMA pacing timer at sample_rate (Hz), returns the rate actually set or
+// 0 without touching the timer if it's below dac_pace_timer_min() or above clk_sys
+uint32_t dac_pace_timer_set(uint timer, uint32_t sample_rate);
+
+// play count frames over and over at sample_rate (Hz), returns the rate actually set
+uint32_t dac_dma_start(const uint16_t *frames, uint count, uint32_t sample_rate);
+// play count frames cycles times then hold the last value
+uint32_t dac_dma_start_burst(const uint16_t *frames, uint count, uint32_t sample_rate, uint cycles);
+// set up a burst but wait for dac_dma_trigger() to start it, safe to call from an IRQ
+uint32_t dac_dma_arm_burst(const uint16_t *frames, uint count, uint32_t sample_rate, uint cycles);
+void dac_dma_trigger(void);
+void dac_dma_stop(void);
+// true while the DMA owns the DAC chip select (started or armed)
+bool dac_dma_running(void);
+// true while frames are actually being clocked out
+bool dac_dma_busy(void);
+
+#endif
@@ -0,0 +1,400 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "ram_cache.h"
+
+#if PICO_ON_DEVICE
+#include "spi_ram.h"
+#include "tlog.h"
+#else
+// the 23K256 as an array, and a clock that only moves by the time each
+// transaction would have on the bus: command, address and data at RAM_BAUD
+// plus the bus's set up around it
+#define SPI_RAM_SIZE 0x8000
+#define RAM_BAUD     (10*1000*1000)
+#define XFER_SETUP_NS 3000 // SPI_BUS_SETUP_US
+#define TLOG_BASE    0x4000
+
+union FloatInt {
+    float f;
+    uint32_t i;
+};
+
+static uint8_t chip[SPI_RAM_SIZE];
+static uint64_t bus_ns;
+
+static void chip_xfer(uint16_t addr, uint8_t *rd, const uint8_t *wr, size_t len){
+    for (size_t i = 0; i < len; i++){
+        uint32_t a = (addr + i) & (SPI_RAM_SIZE - 1);
+        if (wr){
+            chip[a] = wr[i];
+        }
+        else {
+            rd[i] = chip[a];
+        }
+    }
+    bus_ns += (3 + len) * 8 * 1000000000ull / RAM_BAUD + XFER_SETUP_NS;
+}
+
+static uint64_t time_us_64(void){
+    return bus_ns / 1000;
+}
+
+static bool spi_ram_write_block(uint16_t addr, const uint8_t *buf, size_t len){
+    chip_xfer(addr, NULL, buf, len);
+    return true;
+}
+
+static bool spi_ram_read_block(uint16_t addr, uint8_t *buf, size_t len){
+    chip_xfer(addr, buf, NULL, len);
+    return true;
+}
+
+static bool spi_ram_write(uint16_t addr, float v){
+    union FloatInt num;
+    num.f = v;
+    uint8_t b[4] = {num.i >> 24, num.i >> 16, num.i >> 8, num.i};
+    chip_xfer(addr, NULL, b, 4);
+    return true;
+}
+
+static bool spi_ram_read(uint16_t addr, float *v){
+    uint8_t b[4];
+    chip_xfer(addr, b, NULL, 4);
+    union FloatInt num;
+    num.i = ((uint32_t)b[0] << 24) | ((uint32_t)b[1] << 16) | ((uint32_t)b[2] << 8) | b[3];
+    *v = num.f;
+    return true;
+}
+#endif
+
+#define PAGE_MASK (RAM_CACHE_PAGE_SIZE - 1)
+#define NO_PAGE 0xFFFFFFFF
+
+#if (RAM_CACHE_PAGE_SIZE & PAGE_MASK) || SPI_RAM_SIZE % RAM_CACHE_PAGE_SIZE
+#error RAM_CACHE_PAGE_SIZE must be a power of 2 that divides the RAM size
+#endif
+
+typedef struct {
+    uint32_t base;  // chip address of the page, NO_PAGE when empty
+    uint32_t used;  // LRU stamp, bigger is more recent
+    bool dirty;
+    uint8_t data[RAM_CACHE_PAGE_SIZE];
+} page_t;
+
+static page_t pages[RAM_CACHE_PAGES];
+static uint32_t lru_clock = 0;
+static uint last = 0; // page of the previous access, sequential access hits it again
+static ram_cache_stats_t stats;
+
+// false if the bus refused it, the page stays dirty for next time
+static bool writeback(page_t *p){
+    if (p->dirty){
+        if (!spi_ram_write_block(p->base, p->data, RAM_CACHE_PAGE_SIZE)){
+            return false;
+        }
+        p->dirty = false;
+        stats.writebacks++;
+    }
+    return true;
+}
+
+// find the page holding base, or evict the LRU one for it.
+// fill is false when the caller is about to overwrite the whole page.
+// NULL if the bus refused the write back or the fill, nothing is lost: a victim
+// that couldn't be written back keeps its data, one that could is left empty
+static page_t *lookup(uint32_t base, bool fill){
+    page_t *p = &pages[last];
+    if (p->base == base){
+        stats.hits++;
+        p->used = ++lru_clock;
+        return p;
+    }
+
+    uint victim = 0;
+    for (uint i = 0; i < RAM_CACHE_PAGES; i++){
+        if (pages[i].base == base){
+            stats.hits++;
+            last = i;
+            pages[i].used = ++lru_clock;
+            return &pages[i];
+        }
+        if (pages[i].used < pages[victim].used){
+            victim = i;
+        }
+    }
+
+    stats.misses++;
+    p = &pages[victim];
+    if (p->base != NO_PAGE && !writeback(p)){
+        return NULL;
+    }
+    if (fill){
+        if (!spi_ram_read_block(base, p->data, RAM_CACHE_PAGE_SIZE)){
+            p->base = NO_PAGE;
+            p->used = 0;
+            return NULL;
+        }
+        stats.fills++;
+    }
+    p->base = base;
+    last = victim;
+    p->used = ++lru_clock;
+    return p;
+}
+
+void ram_cache_init(void){
+    for (uint i = 0; i < RAM_CACHE_PAGES; i++){
+        pages[i].base = NO_PAGE;
+        pages[i].used = 0;
+        pages[i].dirty = false;
+    }
+    lru_clock = 0;
+    last = 0;
+    ram_cache_reset_stats();
+}
+
+bool ram_cache_read(uint16_t addr, void *buf, size_t len){
+    uint8_t *out = buf;
+    uint32_t a = addr & (SPI_RAM_SIZE - 1);
+    while (len > 0){
+        uint32_t offset = a & PAGE_MASK;
+        size_t n = RAM_CACHE_PAGE_SIZE - offset;
+        if (n > len){
+            n = len;
+        }
+        page_t *p = lookup(a - offset, true);
+        if (!p){
+            return false;
+        }
+        memcpy(out, &p->data[offset], n);
+        out += n;
+        len -= n;
+        a = (a + n) & (SPI_RAM_SIZE - 1);
+    }
+    return true;
+}
+
+bool ram_cache_write(uint16_t addr, const void *buf, size_t len){
+    const uint8_t *in = buf;
+    uint32_t a = addr & (SPI_RAM_SIZE - 1);
+    while (len > 0){
+        uint32_t offset = a & PAGE_MASK;
+        size_t n = RAM_CACHE_PAGE_SIZE - offset;
+        if (n > len){
+            n = len;
+        }
+        // a whole page write doesn't need the old contents
+        page_t *p = lookup(a - offset, n != RAM_CACHE_PAGE_SIZE);
+        if (!p){
+            return false;
+        }
+        memcpy(&p->data[offset], in, n);
+        p->dirty = true;
+        in += n;
+        len -= n;
+        a = (a + n) & (SPI_RAM_SIZE - 1);
+    }
+    return true;
+}
+
+bool ram_cache_read_float(uint16_t addr, float *v){
+    uint8_t b[4];
+    if (!ram_cache_read(addr, b, 4)){
+        return false;
+    }
+
+    union FloatInt num;
+    num.i = ((uint32_t)b[0] << 24) |
+            ((uint32_t)b[1] << 16) |
+            ((uint32_t)b[2] << 8)  |
+            ((uint32_t)b[3]);
+    *v = num.f;
+    return true;
+}
+
+bool ram_cache_write_float(uint16_t addr, float v){
+    union FloatInt num;
+    num.f = v;
+
+    uint8_t b[4];
+    b[0] = (num.i>>24)&0xFF;
+    b[1] = (num.i>>16)&0xFF;
+    b[2] = (num.i>>8)&0xFF;
+    b[3] = num.i&0xFF;
+    return ram_cache_write(addr, b, 4);
+}
+
+bool ram_cache_flush(void){
+    bool ok = true;
+    for (uint i = 0; i < RAM_CACHE_PAGES; i++){
+        if (pages[i].base != NO_PAGE && !writeback(&pages[i])){
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+bool ram_cache_invalidate(void){
+    bool ok = ram_cache_flush();
+    for (uint i = 0; i < RAM_CACHE_PAGES; i++){
+        // a page that couldn't be written back is the only copy, keep it
+        if (!pages[i].dirty){
+            pages[i].base = NO_PAGE;
+            pages[i].used = 0;
+        }
+    }
+    return ok;
+}
+
+void ram_cache_get_stats(ram_cache_stats_t *s){
+    *s = stats;
+}
+
+void ram_cache_reset_stats(void){
+    stats = (ram_cache_stats_t){0};
+}
+
+// the benchmark runs every trace twice, straight to the chip in the low half
+// and through the cache in the high half of what's below the telemetry log,
+// then compares the two halves. The log above keeps recording through it
+#define HALF        (TLOG_BASE / 2)
+#define DIRECT_BASE 0x0000
+#define CACHED_BASE HALF
+#define BENCH_MAX   (HALF / 4)
+
+static uint32_t lcg;
+
+static uint rand_addr(uint span){
+    lcg = lcg * 1664525 + 1013904223;
+    return ((lcg >> 8) % (span / 4)) * 4;
+}
+
+static bool clear_halves(void){
+    static const uint8_t zeros[256];
+    for (uint a = 0; a < 2 * HALF; a += sizeof(zeros)){
+        if (!spi_ram_write_block(a, zeros, sizeof(zeros))){
+            return false;
+        }
+    }
+    return true;
+}
+
+// mismatched blocks, a block that couldn't be read counts as one
+static uint compare_halves(void){
+    uint8_t a[64], b[64];
+    uint errors = 0;
+    for (uint off = 0; off < HALF; off += sizeof(a)){
+        if (!spi_ram_read_block(DIRECT_BASE + off, a, sizeof(a)) ||
+            !spi_ram_read_block(CACHED_BASE + off, b, sizeof(b)) ||
+            memcmp(a, b, sizeof(a)) != 0){
+            errors++;
+        }
+    }
+    return errors;
+}
+
+static void print_row(const char *name, uint64_t direct, uint64_t cached){
+    ram_cache_stats_t s;
+    ram_cache_get_stats(&s);
+    uint total = s.hits + s.misses;
+    if (cached == 0){
+        cached = 1; // under a microsecond, don't divide by it
+    }
+    printf("%-14s %10llu %10llu %7llu.%llux %7u%%\n", name, (unsigned long long)direct,
+           (unsigned long long)cached, (unsigned long long)(direct / cached),
+           (unsigned long long)(direct * 10 / cached % 10),
+           total ? (uint)(s.hits * 100ull / total) : 0);
+}
+
+// sequential: write n floats then read them back.
+// random: read-modify-write n floats at random addresses in a span of bytes.
+// false if the bus refused an access, direct or through the cache
+static bool run_trace(const char *name, uint n, uint span){
+    uint64_t t0, direct, cached;
+    bool ok = true;
+
+    ok = ram_cache_invalidate();
+    ram_cache_reset_stats();
+    if (span == 0){
+        t0 = time_us_64();
+        for (uint i = 0; i < n && ok; i++){
+            ok = spi_ram_write(DIRECT_BASE + i * 4, (float)i);
+        }
+        volatile float sum = 0; // keep the reads
+        for (uint i = 0; i < n && ok; i++){
+            float v = 0;
+            ok = spi_ram_read(DIRECT_BASE + i * 4, &v);
+            sum += v;
+        }
+        direct = time_us_64() - t0;
+
+        t0 = time_us_64();
+        for (uint i = 0; i < n && ok; i++){
+            ok = ram_cache_write_float(CACHED_BASE + i * 4, (float)i);
+        }
+        for (uint i = 0; i < n && ok; i++){
+            float v = 0;
+            ok = ram_cache_read_float(CACHED_BASE + i * 4, &v);
+            sum -= v;
+        }
+        ok = ok && ram_cache_flush();
+        cached = time_us_64() - t0;
+    }
+    else {
+        lcg = 433;
+        t0 = time_us_64();
+        for (uint i = 0; i < n && ok; i++){
+            uint a = DIRECT_BASE + rand_addr(span);
+            float v = 0;
+            ok = spi_ram_read(a, &v) && spi_ram_write(a, v + 1.0f);
+        }
+        direct = time_us_64() - t0;
+
+        lcg = 433;
+        t0 = time_us_64();
+        for (uint i = 0; i < n && ok; i++){
+            uint a = CACHED_BASE + rand_addr(span);
+            float v = 0;
+            ok = ram_cache_read_float(a, &v) && ram_cache_write_float(a, v + 1.0f);
+        }
+        ok = ok && ram_cache_flush();
+        cached = time_us_64() - t0;
+    }
+    if (!ok){
+        printf("%-14s the bus is claimed, stop playback first\n", name);
+        return false;
+    }
+    print_row(name, direct, cached);
+    return true;
+}
+
+void ram_cache_benchmark(uint n){
+    if (n > BENCH_MAX){
+        n = BENCH_MAX;
+    }
+    if (!clear_halves()){
+        printf("RAM cache: the bus is claimed, stop playback first\n");
+        return;
+    }
+
+    printf("RAM cache, %u x %u byte pages, %u accesses per trace\n",
+           RAM_CACHE_PAGES, RAM_CACHE_PAGE_SIZE, n);
+    printf("%-14s %10s %10s %9s %8s\n", "", "direct us", "cached us", "speedup", "hits");
+    if (run_trace("sequential", n, 0) && run_trace("random 1KB", n, 1024) &&
+        run_trace("random 4KB", n, 4096) && run_trace("random 8KB", n, HALF)){
+        printf("mismatched 64 byte blocks: %u\n", compare_halves());
+    }
+
+    ram_cache_invalidate();
+    ram_cache_reset_stats();
+}
+
+#if !PICO_ON_DEVICE
+int main(int argc, char **argv){
+    uint n = argc > 1 ? (uint)atoi(argv[1]) : 1024;
+    ram_cache_init();
+    ram_cache_benchmark(n);
+    return 0;
+}
+#endif
@@ -0,0 +1,64 @@
+#ifndef RAM_CACHE_H__
+#define RAM_CACHE_H__
+
+#if PICO_ON_DEVICE
+#include "pico/stdlib.h"
+#else
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+typedef unsigned int uint;
+#endif
+
+// Write-back page cache in on-chip RAM in front of the 23K256.
+// Reads and writes land in RAM_CACHE_PAGES pages of RAM_CACHE_PAGE_SIZE bytes;
+// a miss fetches the whole page in one burst, the least recently used page is
+// evicted and only written back if it was dirtied. Nothing reaches the chip
+// until a page is evicted or ram_cache_flush() is called.
+//
+// Don't mix cached and direct spi_ram_* access to the same addresses without a
+// flush (before a direct read) or an invalidate (after a direct write).
+//
+// The file also builds on a PC against a simulated chip, where the benchmark's
+// times are what the SPI transactions would take at RAM_BAUD:
+//   gcc -O2 -o ram_cache ram_cache.c && ./ram_cache 1024
+
+#ifndef RAM_CACHE_PAGE_SIZE
+#define RAM_CACHE_PAGE_SIZE 64 // bytes, power of 2
+#endif
+#ifndef RAM_CACHE_PAGES
+#define RAM_CACHE_PAGES 16
+#endif
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t writebacks; // dirty pages written to the chip
+    uint32_t fills;      // pages read from the chip
+} ram_cache_stats_t;
+
+void ram_cache_init(void);
+
+// byte addressed, any length, may cross pages and wraps at 32KB like the chip.
+// false if a miss needed the bus and it was refused (DAC playback holds it, see
+// spi_ram.h): the pages before that one are done, no cached data is lost
+bool ram_cache_read(uint16_t addr, void *buf, size_t len);
+bool ram_cache_write(uint16_t addr, const void *buf, size_t len);
+
+// same byte order as spi_ram_read/spi_ram_write
+bool ram_cache_read_float(uint16_t addr, float *v);
+bool ram_cache_write_float(uint16_t addr, float v);
+
+// write every dirty page back, the pages stay cached. false if any was refused,
+// those stay dirty
+bool ram_cache_flush(void);
+// flush, then drop every page that's clean
+bool ram_cache_invalidate(void);
+
+void ram_cache_get_stats(ram_cache_stats_t *stats);
+void ram_cache_reset_stats(void);
+
+// time sequential and random float traces of n accesses with and without the cache
+void ram_cache_benchmark(uint n);
+
+#endif
@@ -0,0 +1,310 @@
+#include "ram_stream.h"
+#include "dac_dma.h"
+#include "spi_ram.h"
+#include "spi_bus.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+
+#define RAM_READ 0b00000011
+#define IRQ_BUDGET_US 4 // the two IRQs and format switches around a fetch
+
+static spi_inst_t *stream_spi;
+static uint stream_cs;
+
+static int dac_chan;   // timer paced, buffer -> SPI
+static int drain_chan; // SPI -> sink under the DAC frames, finishing means the bus is quiet
+static int tx_chan;    // read command then dummy bytes to clock a fetch
+static int hdr_chan;   // SPI -> sink under the read command, then starts rx_chan
+static int rx_chan;    // SPI -> idle buffer during a fetch
+static int pace_timer;
+
+static uint16_t buf[2][STREAM_BLOCK_MAX];
+static uint8_t tx_cmd[3 + STREAM_BLOCK_MAX * 2]; // read command, the rest stays zero
+static uint32_t sink;
+static volatile uint cur; // buffer the DAC is playing
+static uint play_pos;     // next frame of buf[cur] to play
+static uint fill_pos;     // next frame of buf[cur ^ 1] to fetch
+static uint slice_left;   // frames of the current fetch slice still to read
+static uint16_t base;
+static uint total;
+static uint pos;          // next frame to fetch, relative to base
+static uint period_us;
+static uint32_t budget_us; // bus time in the gap after a slice is played
+static uint32_t lend_us;   // what a fetch leaves of it for other devices
+static uint32_t quiet_us; // when the last played slice finished shifting out
+static volatile bool running = false;
+static ram_stream_stats_t stats;
+
+static inline void ram_select(bool on){
+    asm volatile("nop \n nop \n nop");
+    gpio_put(RAM_CS, !on);
+    asm volatile("nop \n nop \n nop");
+}
+
+// the next slice of the playing buffer out to the DAC, swapping buffers once it's
+// used up (the idle one has had as many fetch slices as this one had plays)
+static void play_slice(void){
+    if (play_pos >= stats.block_len){
+        cur ^= 1;
+        play_pos = 0;
+        fill_pos = 0;
+        stats.blocks++;
+    }
+    uint n = stats.block_len - play_pos;
+    if (n > stats.slice_len){
+        n = stats.slice_len;
+    }
+
+    // 16 bit frames, hardware CSn for the DAC
+    spi_set_format(stream_spi, 16, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    gpio_set_function(stream_cs, GPIO_FUNC_SPI);
+    dma_channel_transfer_to_buffer_now(drain_chan, &sink, n);
+    dma_channel_transfer_from_buffer_now(dac_chan, &buf[cur][play_pos], n);
+    play_pos += n;
+}
+
+// one burst read of what's left of the slice into the idle buffer, stopping short
+// at the end of the loop. rx_chan raises the IRQ when it lands
+static void fetch(void){
+    uint len = slice_left;
+    if (len > total - pos){
+        len = total - pos;
+    }
+    uint16_t addr = base + pos * 2;
+
+    // park the DAC chip select high so it ignores the RAM traffic, then byte frames
+    gpio_set_function(stream_cs, GPIO_FUNC_SIO);
+    spi_set_format(stream_spi, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+
+    tx_cmd[1] = (addr>>8) & 0xFF;
+    tx_cmd[2] = addr & 0xFF;
+    ram_select(true);
+    dma_channel_set_write_addr(rx_chan, &buf[cur ^ 1][fill_pos], false);
+    dma_channel_set_trans_count(rx_chan, len * 2, false);
+    dma_channel_set_trans_count(hdr_chan, 3, false);
+    dma_channel_set_read_addr(tx_chan, tx_cmd, false);
+    dma_channel_set_trans_count(tx_chan, 3 + len * 2, false);
+    dma_start_channel_mask((1u << hdr_chan) | (1u << tx_chan));
+
+    fill_pos += len;
+    slice_left -= len;
+    pos += len;
+    if (pos >= total){
+        pos = 0;
+    }
+}
+
+// after a played slice (or a lent gap), a slice into the idle buffer while it
+// needs one, otherwise straight on with the next slice
+static void next_step(void){
+    if (!running){
+        return;
+    }
+    if (fill_pos < stats.block_len){
+        slice_left = stats.block_len - fill_pos;
+        if (slice_left > stats.slice_len){
+            slice_left = stats.slice_len;
+        }
+        fetch();
+    }
+    else {
+        play_slice();
+    }
+}
+
+static void dma_handler(){
+    if (dma_channel_get_irq0_status(drain_chan)){
+        dma_channel_acknowledge_irq0(drain_chan);
+        if (!running){
+            return;
+        }
+        quiet_us = time_us_32();
+        if (spi_bus_waiting()){
+            // another device gets what the fetch won't use, all of it with no fetch
+            gpio_set_function(stream_cs, GPIO_FUNC_SIO);
+            if (spi_bus_lend(fill_pos < stats.block_len ? lend_us : budget_us, next_step)){
+                return;
+            }
+        }
+        next_step();
+    }
+    if (dma_channel_get_irq0_status(rx_chan)){
+        dma_channel_acknowledge_irq0(rx_chan);
+        if (!running){
+            return;
+        }
+        ram_select(false);
+        if (slice_left){
+            // the slice ran over the end of the loop, read the rest from the start
+            fetch();
+            return;
+        }
+        play_slice();
+
+        uint32_t gap = time_us_32() - quiet_us;
+        if (gap > stats.max_gap_us){
+            stats.max_gap_us = gap;
+        }
+        if (gap >= period_us){
+            stats.late++;
+        }
+    }
+}
+
+void ram_stream_init(spi_inst_t *spi, uint dac_cs){
+    stream_spi = spi;
+    stream_cs = dac_cs;
+    dac_chan = dma_claim_unused_channel(true);
+    drain_chan = dma_claim_unused_channel(true);
+    tx_chan = dma_claim_unused_channel(true);
+    hdr_chan = dma_claim_unused_channel(true);
+    rx_chan = dma_claim_unused_channel(true);
+    pace_timer = dma_claim_unused_timer(true);
+    tx_cmd[0] = RAM_READ;
+
+    dma_channel_config c = dma_channel_get_default_config(rx_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, true);
+    channel_config_set_dreq(&c, spi_get_dreq(spi, false));
+    dma_channel_configure(rx_chan, &c, NULL, &spi_get_hw(spi)->dr, 0, false);
+
+    c = dma_channel_get_default_config(hdr_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, spi_get_dreq(spi, false));
+    channel_config_set_chain_to(&c, rx_chan);
+    dma_channel_configure(hdr_chan, &c, &sink, &spi_get_hw(spi)->dr, 3, false);
+
+    c = dma_channel_get_default_config(tx_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, spi_get_dreq(spi, true));
+    dma_channel_configure(tx_chan, &c, &spi_get_hw(spi)->dr, tx_cmd, 0, false);
+
+    c = dma_channel_get_default_config(dac_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, dma_get_timer_dreq(pace_timer));
+    dma_channel_configure(dac_chan, &c, &spi_get_hw(spi)->dr, NULL, 0, false);
+
+    c = dma_channel_get_default_config(drain_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_16);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, spi_get_dreq(spi, false));
+    dma_channel_configure(drain_chan, &c, &sink, &spi_get_hw(spi)->dr, 0, false);
+
+    irq_add_shared_handler(DMA_IRQ_0, dma_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+}
+
+uint32_t ram_stream_start(uint16_t addr, uint count, uint32_t sample_rate){
+    ram_stream_stop();
+    dac_dma_stop(); // we need the bus to ourselves
+
+    if (count == 0 || sample_rate == 0){
+        return 0;
+    }
+    // fetches go in the gaps between timer ticks, there's no PWM fallback here
+    uint32_t rate = dac_pace_timer_set(pace_timer, sample_rate);
+    if (rate == 0){
+        return 0;
+    }
+
+    // frames one fetch can bring in within 3/4 of a real sample period, less the
+    // IRQs and two 3 byte read commands (a slice over the end of the loop takes two)
+    uint32_t period_ns = 1000000000u / rate;
+    period_us = period_ns / 1000;
+    int64_t budget_ns = (int64_t)period_ns * 3 / 4 - IRQ_BUDGET_US * 1000;
+    uint baud = spi_get_baudrate(stream_spi);
+    int64_t bytes = budget_ns * baud / 8 / 1000000000 - 6;
+    if (bytes < 2){
+        return 0;
+    }
+    stats.slice_len = bytes / 2 > STREAM_BLOCK_MAX ? STREAM_BLOCK_MAX : bytes / 2;
+    if (stats.slice_len > count){
+        stats.slice_len = count; // so a slice never wraps more than once
+    }
+    stats.block_len = STREAM_BLOCK_MAX / stats.slice_len * stats.slice_len;
+    budget_us = budget_ns / 1000;
+    uint32_t fetch_us = (uint32_t)((6 + stats.slice_len * 2) * 8 * 1000000ull / baud) + 1;
+    lend_us = budget_us > fetch_us ? budget_us - fetch_us : 0;
+    stats.blocks = 0;
+    stats.late = 0;
+    stats.max_gap_us = 0;
+
+    base = addr;
+    total = count;
+    pos = 0;
+
+    // prime both buffers before the clock starts
+    for (uint b = 0; b < 2; b++){
+        for (uint f = 0; f < stats.block_len; ){
+            uint len = stats.block_len - f;
+            if (len > total - pos){
+                len = total - pos;
+            }
+            if (!spi_ram_read_block(base + pos * 2, (uint8_t *)&buf[b][f], len * 2)){
+                return 0; // someone else has claimed the bus
+            }
+            f += len;
+            pos += len;
+            if (pos >= total){
+                pos = 0;
+            }
+        }
+    }
+
+    // from here on the fetches drive the SPI block directly, other devices get
+    // what's spare in the gaps
+    spi_bus_claim(NULL, lend_us);
+    dma_channel_set_irq0_enabled(drain_chan, true);
+    dma_channel_set_irq0_enabled(rx_chan, true);
+    cur = 0;
+    play_pos = 0;
+    fill_pos = stats.block_len; // both full
+    slice_left = 0;
+    running = true;
+    play_slice();
+    return rate;
+}
+
+void ram_stream_stop(void){
+    if (!running){
+        return;
+    }
+    running = false;
+    dma_channel_set_irq0_enabled(drain_chan, false);
+    dma_channel_set_irq0_enabled(rx_chan, false);
+    dma_channel_abort(dac_chan);
+    dma_channel_abort(drain_chan);
+    dma_channel_abort(tx_chan);
+    dma_channel_abort(hdr_chan);
+    dma_channel_abort(rx_chan);
+    while (spi_bus_lending() || spi_is_busy(stream_spi)){
+        tight_loop_contents();
+    }
+    // flush anything a cut off slice left in the RX FIFO
+    while (spi_is_readable(stream_spi)){
+        (void)spi_get_hw(stream_spi)->dr;
+    }
+
+    ram_select(false);
+    gpio_put(stream_cs, 1);
+    gpio_set_dir(stream_cs, GPIO_OUT);
+    gpio_set_function(stream_cs, GPIO_FUNC_SIO);
+    spi_set_format(stream_spi, 8, SPI_CPOL_0, SPI_CPHA_0, SPI_MSB_FIRST);
+    spi_bus_release();
+}
+
+bool ram_stream_running(void){
+    return running;
+}
+
+void ram_stream_get_stats(ram_stream_stats_t *s){
+    *s = stats;
+}
@@ -0,0 +1,38 @@
+#ifndef RAM_STREAM_H__
+#define RAM_STREAM_H__
+
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+
+// Continuous DAC playback straight out of the 23K256.
+// Frames (as built by dac_frame) sit in the external RAM as raw bytes. Two local
+// buffers ping-pong: the pacing timer clocks one out to the DAC while the other
+// is refilled. The DAC and the RAM share spi0, so both buffers are worked
+// through in slices: a slice of frames is played, and in the gap before the next
+// sample tick a burst read brings a slice into the idle buffer. The slice is
+// sized from the real sample rate so the read always fits in the gap; by the
+// time the playing buffer runs out the idle one is full. It's all DMA, the IRQ
+// only switches the bus between the two chips. Whatever a fetch leaves of the
+// gap is lent to transfers queued on the bus (see spi_bus.h); at the top rates
+// that's nothing and they wait for the stream to stop.
+
+#define STREAM_BLOCK_MAX 256 // frames per buffer
+
+typedef struct {
+    uint block_len;     // frames per buffer
+    uint slice_len;     // frames played or fetched per step
+    uint32_t blocks;    // blocks played
+    uint32_t late;      // fetches that ran past the sample period
+    uint32_t max_gap_us; // longest fetch, bus quiet to the DAC armed again
+} ram_stream_stats_t;
+
+void ram_stream_init(spi_inst_t *spi, uint dac_cs);
+// loop count frames starting at addr, returns the sample rate set or 0 if the
+// rate is below dac_pace_timer_min() or too high to refill between samples at
+// the current SPI baud, or if the RAM can't be read to prime the buffers
+uint32_t ram_stream_start(uint16_t addr, uint count, uint32_t sample_rate);
+void ram_stream_stop(void);
+bool ram_stream_running(void);
+void ram_stream_get_stats(ram_stream_stats_t *stats);
+
+#endif
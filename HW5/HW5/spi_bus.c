@@ -0,0 +1,347 @@
+#include "spi_bus.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+
+static spi_inst_t *bus_spi;
+static int tx_chan;
+static int rx_chan;
+static spin_lock_t *lock;
+
+static spi_device_t *devices[SPI_BUS_MAX_DEVICES];
+static uint num_devices = 0;
+static uint next_device = 0; // round robin pointer
+
+static spi_xfer_t *active = NULL;
+static spi_device_t *configured = NULL; // device the SPI block is set up for
+static volatile bool claimed = false;
+static spi_bus_gap_cb_t wantGap;           // holder's, while claimed
+static spi_bus_gap_cb_t lentResume;
+static volatile bool lending = false;      // a lent transfer is on the wire
+static uint32_t claimGapUs;
+static uint claimBaud;
+static uint64_t active_start_us;
+static spi_bus_stats_t stats;
+
+static uint32_t zero = 0;
+static uint32_t sink;
+
+static inline void cs_select(uint cs_pin) {
+    asm volatile("nop \n nop \n nop");
+    gpio_put(cs_pin, 0);
+    asm volatile("nop \n nop \n nop");
+}
+
+static inline void cs_deselect(uint cs_pin) {
+    asm volatile("nop \n nop \n nop");
+    gpio_put(cs_pin, 1);
+    asm volatile("nop \n nop \n nop");
+}
+
+uint32_t spi_bus_xfer_us(const spi_xfer_t *x){
+    uint64_t bits = (uint64_t)x->header_len * 8 + (uint64_t)x->len * x->dev->data_bits;
+    return (uint32_t)((bits * 1000000 + x->dev->baud - 1) / x->dev->baud) + SPI_BUS_SETUP_US;
+}
+
+// take the first transfer off the next device with work that fits in max_us,
+// round robin so one busy device can't starve the rest. called with the lock held
+static spi_xfer_t *take_next(uint32_t max_us){
+    for (uint i = 0; i < num_devices; i++){
+        spi_device_t *d = devices[(next_device + i) % num_devices];
+        spi_xfer_t *x = d->head;
+        if (x && (max_us == UINT32_MAX || spi_bus_xfer_us(x) <= max_us)){
+            next_device = (next_device + i + 1) % num_devices;
+            d->head = x->next;
+            if (!d->head){
+                d->tail = NULL;
+            }
+            return x;
+        }
+    }
+    return NULL;
+}
+
+static void start(spi_xfer_t *x){
+    spi_device_t *dev = x->dev;
+    active = x;
+    active_start_us = time_us_64();
+
+    if (configured != dev){
+        spi_set_baudrate(bus_spi, dev->baud);
+        spi_set_format(bus_spi, dev->data_bits, dev->cpol, dev->cpha, SPI_MSB_FIRST);
+        configured = dev;
+    }
+
+    cs_select(dev->cs_pin);
+
+    // a few header bytes fit in the FIFO, push them and throw away what comes back
+    if (x->header_len){
+        spi_write_blocking(bus_spi, x->header, x->header_len);
+    }
+
+    enum dma_channel_transfer_size size = dev->data_bits > 8 ? DMA_SIZE_16 : DMA_SIZE_8;
+
+    dma_channel_config c = dma_channel_get_default_config(tx_chan);
+    channel_config_set_transfer_data_size(&c, size);
+    channel_config_set_read_increment(&c, x->tx != NULL);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, spi_get_dreq(bus_spi, true));
+    dma_channel_configure(tx_chan, &c, &spi_get_hw(bus_spi)->dr,
+                          x->tx ? x->tx : (const void *)&zero, x->len, false);
+
+    c = dma_channel_get_default_config(rx_chan);
+    channel_config_set_transfer_data_size(&c, size);
+    channel_config_set_read_increment(&c, false);
+    channel_config_set_write_increment(&c, x->rx != NULL);
+    channel_config_set_dreq(&c, spi_get_dreq(bus_spi, false));
+    dma_channel_configure(rx_chan, &c, x->rx ? x->rx : (void *)&sink,
+                          &spi_get_hw(bus_spi)->dr, x->len, false);
+
+    // rx finishing means every frame has been clocked, so it signals completion
+    dma_start_channel_mask((1u << tx_chan) | (1u << rx_chan));
+}
+
+// called with the lock held
+static void start_next(){
+    if (active || claimed){
+        return;
+    }
+    spi_xfer_t *x = take_next(UINT32_MAX);
+    if (x){
+        start(x);
+    }
+}
+
+static void finish(spi_xfer_t *x){
+    spi_device_t *dev = x->dev;
+    cs_deselect(dev->cs_pin);
+    dev->depth--;
+    stats.depth--;
+    stats.completed++;
+    stats.busy_us += time_us_64() - active_start_us;
+    active = NULL;
+}
+
+static void dma_handler(){
+    if (!dma_channel_get_irq1_status(rx_chan)){
+        return;
+    }
+    dma_channel_acknowledge_irq1(rx_chan);
+
+    uint32_t save = spin_lock_blocking(lock);
+    spi_xfer_t *x = active;
+    if (x){
+        finish(x);
+    }
+    spin_unlock(lock, save);
+
+    if (x){
+        x->complete = true;
+        if (x->done){
+            x->done(x);
+        }
+    }
+
+    save = spin_lock_blocking(lock);
+    lending = false;
+    if (!claimed){
+        start_next();
+        spin_unlock(lock, save);
+        return;
+    }
+    // a lent gap, hand the bus back at the holder's baud
+    spi_bus_gap_cb_t resume = lentResume;
+    lentResume = NULL;
+    configured = NULL;
+    if (spi_get_baudrate(bus_spi) != claimBaud){
+        spi_set_baudrate(bus_spi, claimBaud);
+    }
+    spi_bus_gap_cb_t want = wantGap;
+    spin_unlock(lock, save);
+
+    if (resume){
+        resume();
+    }
+    if (want && spi_bus_waiting()){
+        want();
+    }
+}
+
+void spi_bus_init(spi_inst_t *spi){
+    bus_spi = spi;
+    tx_chan = dma_claim_unused_channel(true);
+    rx_chan = dma_claim_unused_channel(true);
+    lock = spin_lock_instance(spin_lock_claim_unused(true));
+    spi_bus_reset_stats();
+
+    irq_add_shared_handler(DMA_IRQ_1, dma_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    dma_channel_set_irq1_enabled(rx_chan, true);
+    irq_set_enabled(DMA_IRQ_1, true);
+}
+
+void spi_bus_add_device(spi_device_t *dev, uint cs_pin, uint baud, uint data_bits,
+                        spi_cpol_t cpol, spi_cpha_t cpha){
+    dev->cs_pin = cs_pin;
+    dev->baud = baud;
+    dev->data_bits = data_bits;
+    dev->cpol = cpol;
+    dev->cpha = cpha;
+    dev->head = NULL;
+    dev->tail = NULL;
+    dev->depth = 0;
+    dev->max_depth = 0;
+
+    //Chip select is active-low, so we'll initialise it to a driven-high state
+    gpio_init(cs_pin);
+    gpio_put(cs_pin, 1);
+    gpio_set_dir(cs_pin, GPIO_OUT);
+
+    uint32_t save = spin_lock_blocking(lock);
+    hard_assert(num_devices < SPI_BUS_MAX_DEVICES);
+    devices[num_devices++] = dev;
+    spin_unlock(lock, save);
+}
+
+// called with the lock held
+static void enqueue(spi_xfer_t *x){
+    x->complete = false;
+    x->next = NULL;
+
+    spi_device_t *dev = x->dev;
+    if (dev->tail){
+        dev->tail->next = x;
+    }
+    else {
+        dev->head = x;
+    }
+    dev->tail = x;
+    if (++dev->depth > dev->max_depth){
+        dev->max_depth = dev->depth;
+    }
+    if (++stats.depth > stats.max_depth){
+        stats.max_depth = stats.depth;
+    }
+    stats.submitted++;
+    start_next();
+}
+
+void spi_bus_submit(spi_xfer_t *x){
+    uint32_t save = spin_lock_blocking(lock);
+    enqueue(x);
+    spi_bus_gap_cb_t want = claimed && !lending ? wantGap : NULL;
+    spin_unlock(lock, save);
+    if (want){
+        want();
+    }
+}
+
+void spi_bus_wait(spi_xfer_t *x){
+    while (!x->complete){
+        tight_loop_contents();
+    }
+}
+
+bool spi_bus_transfer(spi_xfer_t *x){
+    uint32_t save = spin_lock_blocking(lock);
+    if (claimed && spi_bus_xfer_us(x) > claimGapUs){
+        spin_unlock(lock, save);
+        return false;
+    }
+    enqueue(x);
+    spi_bus_gap_cb_t want = claimed && !lending ? wantGap : NULL;
+    spin_unlock(lock, save);
+    if (want){
+        want();
+    }
+    spi_bus_wait(x);
+    return true;
+}
+
+void spi_bus_claim(spi_bus_gap_cb_t want_gap, uint32_t max_gap_us){
+    while (true){
+        uint32_t save = spin_lock_blocking(lock);
+        if (!active && !claimed){
+            claimed = true;
+            wantGap = want_gap;
+            claimGapUs = max_gap_us;
+            claimBaud = spi_get_baudrate(bus_spi);
+            configured = NULL; // whoever claims it will change the format
+            stats.claims++;
+            spin_unlock(lock, save);
+            break;
+        }
+        spin_unlock(lock, save);
+        tight_loop_contents();
+    }
+    while (spi_is_busy(bus_spi)){
+        tight_loop_contents();
+    }
+}
+
+bool spi_bus_lend(uint32_t gap_us, spi_bus_gap_cb_t resume){
+    bool lent = false;
+    uint32_t save = spin_lock_blocking(lock);
+    if (claimed && !active){
+        spi_xfer_t *x = take_next(gap_us);
+        if (x){
+            lentResume = resume;
+            lending = true;
+            configured = NULL; // the holder had the block set up its own way
+            stats.lends++;
+            start(x);
+            lent = true;
+        }
+    }
+    spin_unlock(lock, save);
+    return lent;
+}
+
+bool spi_bus_waiting(void){
+    uint32_t save = spin_lock_blocking(lock);
+    bool waiting = stats.depth > (active ? 1u : 0u);
+    spin_unlock(lock, save);
+    return waiting;
+}
+
+uint32_t spi_bus_max_xfer_us(void){
+    return claimed ? claimGapUs : UINT32_MAX;
+}
+
+bool spi_bus_lending(void){
+    return lending;
+}
+
+void spi_bus_release(void){
+    uint32_t save = spin_lock_blocking(lock);
+    claimed = false;
+    wantGap = NULL;
+    start_next();
+    spin_unlock(lock, save);
+}
+
+void spi_bus_get_stats(spi_bus_stats_t *s){
+    uint32_t save = spin_lock_blocking(lock);
+    *s = stats;
+    spin_unlock(lock, save);
+}
+
+void spi_bus_reset_stats(void){
+    uint32_t save = spin_lock_blocking(lock);
+    uint depth = stats.depth;
+    stats = (spi_bus_stats_t){0};
+    stats.depth = depth;
+    stats.max_depth = depth;
+    stats.since_us = time_us_64();
+    for (uint i = 0; i < num_devices; i++){
+        devices[i]->max_depth = devices[i]->depth;
+    }
+    spin_unlock(lock, save);
+}
+
+uint spi_bus_utilisation(const spi_bus_stats_t *s){
+    uint64_t window = time_us_64() - s->since_us;
+    if (window == 0){
+        return 0;
+    }
+    return (uint)(s->busy_us * 1000 / window);
+}
@@ -0,0 +1,106 @@
+#ifndef SPI_BUS_H__
+#define SPI_BUS_H__
+
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+
+// Transaction scheduler for several chip selects on one SPI port.
+// Each device keeps its own FIFO of transfers and its own baud/format; the bus
+// round-robins between devices, runs every transfer with a DMA pair and calls the
+// completion callback from the DMA IRQ. The queues sit behind a hardware spin
+// lock so either core (or an IRQ) can submit.
+//
+// Long running DMA users (the DAC pacing timer, the RAM stream) take the whole
+// bus with spi_bus_claim(). They don't keep it to themselves: whenever the bus
+// goes quiet between their frames they can lend the gap with spi_bus_lend(),
+// and a queued transfer that fits in it runs there. The holder parks its
+// hardware chip select first, so any device with a GPIO chip select can share
+// the bus with it; the bus puts the baud back afterwards and the holder its own
+// format. Under HW5 that's the 23K256 (log batches, short reads and writes)
+// and single DAC frames alongside DAC playback or a RAM stream.
+//
+// A transfer longer than the holder's gaps waits for spi_bus_release().
+// spi_bus_transfer() refuses one of those instead of waiting forever.
+
+#define SPI_BUS_MAX_DEVICES 4
+#define SPI_BUS_MAX_HEADER  4 // command/address bytes sent before the data
+#define SPI_BUS_SETUP_US    3 // IRQ and format switches around a lent transfer
+
+struct spi_xfer;
+typedef void (*spi_xfer_cb_t)(struct spi_xfer *xfer);
+typedef void (*spi_bus_gap_cb_t)(void);
+
+typedef struct spi_device {
+    uint cs_pin;
+    uint baud;
+    uint data_bits; // 8 or 16, 16 bit devices move len 16 bit frames
+    spi_cpol_t cpol;
+    spi_cpha_t cpha;
+    struct spi_xfer *head;
+    struct spi_xfer *tail;
+    uint depth;
+    uint max_depth;
+} spi_device_t;
+
+typedef struct spi_xfer {
+    spi_device_t *dev;
+    uint8_t header[SPI_BUS_MAX_HEADER]; // sent first with CS held (8 bit devices only)
+    uint header_len;
+    const void *tx; // NULL clocks out zeros
+    void *rx;       // NULL throws the received data away
+    size_t len;     // frames after the header
+    spi_xfer_cb_t done; // called from the DMA IRQ, may submit more transfers
+    void *user;
+    volatile bool complete;
+    struct spi_xfer *next;
+} spi_xfer_t;
+
+typedef struct {
+    uint32_t submitted;
+    uint32_t completed;
+    uint depth;       // transfers queued or running right now
+    uint max_depth;   // deepest the total queue has been
+    uint64_t busy_us; // time with a transfer on the wire
+    uint64_t since_us; // start of the measurement window
+    uint32_t claims;  // times the bus was handed to a DMA stream
+    uint32_t lends;   // transfers run in a gap the holder lent
+} spi_bus_stats_t;
+
+void spi_bus_init(spi_inst_t *spi);
+void spi_bus_add_device(spi_device_t *dev, uint cs_pin, uint baud, uint data_bits,
+                        spi_cpol_t cpol, spi_cpha_t cpha);
+
+// queue a transfer, returns straight away
+void spi_bus_submit(spi_xfer_t *xfer);
+// wait for a submitted transfer, don't call from an IRQ
+void spi_bus_wait(spi_xfer_t *xfer);
+// submit and wait. false (and nothing queued) if the bus is claimed and the
+// transfer is too long for any gap the holder lends
+bool spi_bus_transfer(spi_xfer_t *xfer);
+// time a transfer takes on the wire, with the set up around it
+uint32_t spi_bus_xfer_us(const spi_xfer_t *xfer);
+
+// wait for the bus to go idle and hold it. max_gap_us is the longest gap the
+// holder promises to keep lending, 0 if it never will. want_gap (or NULL if the
+// holder looks for itself with spi_bus_waiting) is called, maybe from an IRQ,
+// whenever a transfer is waiting for a gap
+void spi_bus_claim(spi_bus_gap_cb_t want_gap, uint32_t max_gap_us);
+// from the holder with the bus quiet and its chip select parked: start the next
+// queued transfer that fits in gap_us. resume is called from the DMA IRQ once
+// it's done, false if nothing fits
+bool spi_bus_lend(uint32_t gap_us, spi_bus_gap_cb_t resume);
+// a transfer is queued while the bus is claimed
+bool spi_bus_waiting(void);
+// the longest spi_bus_xfer_us() that can go now: the holder's gap while the bus
+// is claimed, UINT32_MAX otherwise
+uint32_t spi_bus_max_xfer_us(void);
+// a lent transfer is on the wire, wait for it before changing the bus under it
+bool spi_bus_lending(void);
+void spi_bus_release(void);
+
+void spi_bus_get_stats(spi_bus_stats_t *stats);
+void spi_bus_reset_stats(void);
+// busy time as parts per thousand of the window
+uint spi_bus_utilisation(const spi_bus_stats_t *stats);
+
+#endif
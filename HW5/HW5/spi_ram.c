@@ -0,0 +1,206 @@
+#include <stdio.h>
+#include "spi_ram.h"
+
+#define RAM_WRITE 0b00000010
+#define RAM_READ  0b00000011
+#define CHUNK_WORDS 64 // words byte swapped per transaction by the typed helpers
+
+static spi_device_t ram_dev;
+
+// one bus transaction: command and address header, then len data bytes.
+// false if the bus is claimed and it won't fit in a lent gap
+static bool ram_transfer(uint8_t cmd, uint16_t addr, const void *tx, void *rx, size_t len){
+    spi_xfer_t x = {0};
+    x.dev = &ram_dev;
+    x.header[0] = cmd;
+    x.header[1] = (addr>>8) & 0xFF;
+    x.header[2] = addr & 0xFF;
+    x.header_len = 3;
+    x.tx = tx;
+    x.rx = rx;
+    x.len = len;
+    return spi_bus_transfer(&x);
+}
+
+void spi_ram_init(){
+    spi_bus_add_device(&ram_dev, RAM_CS, RAM_BAUD, 8, SPI_CPOL_0, SPI_CPHA_0);
+
+    uint8_t mode = 0b01000000; // seq mode
+    spi_xfer_t x = {0};
+    x.dev = &ram_dev;
+    x.header[0] = 0b00000001; // write status register
+    x.header_len = 1;
+    x.tx = &mode;
+    x.len = 1;
+    spi_bus_transfer(&x);
+}
+
+bool spi_ram_write(uint16_t addr, float v){
+    uint8_t buf[4];
+    union FloatInt num;
+    num.f = v;
+
+    buf[0] = (num.i>>24)&0xFF;
+    buf[1] = (num.i>>16)&0xFF;
+    buf[2] = (num.i>>8)&0xFF;
+    buf[3] = num.i&0xFF;
+
+    return ram_transfer(RAM_WRITE, addr, buf, NULL, 4);
+}
+
+bool spi_ram_read(uint16_t address, float *v){
+    uint8_t read[4];
+    if (!ram_transfer(RAM_READ, address, NULL, read, 4)){
+        return false;
+    }
+
+    union FloatInt num;
+    num.i = ((uint32_t)read[0] << 24) |
+            ((uint32_t)read[1] << 16) |
+            ((uint32_t)read[2] << 8)  |
+            ((uint32_t)read[3]);
+
+    *v = num.f;
+    return true;
+}
+
+bool spi_ram_write_block(uint16_t addr, const uint8_t *buf, size_t len){
+    return ram_transfer(RAM_WRITE, addr, buf, NULL, len);
+}
+
+bool spi_ram_read_block(uint16_t addr, uint8_t *buf, size_t len){
+    return ram_transfer(RAM_READ, addr, NULL, buf, len);
+}
+
+void spi_ram_submit_write(spi_xfer_t *x, uint16_t addr, const uint8_t *buf, size_t len,
+                          spi_xfer_cb_t done){
+    x->dev = &ram_dev;
+    x->header[0] = RAM_WRITE;
+    x->header[1] = (addr>>8) & 0xFF;
+    x->header[2] = addr & 0xFF;
+    x->header_len = 3;
+    x->tx = buf;
+    x->rx = NULL;
+    x->len = len;
+    x->done = done;
+    spi_bus_submit(x);
+}
+
+size_t spi_ram_max_burst(void){
+    uint32_t us = spi_bus_max_xfer_us();
+    if (us == UINT32_MAX){
+        return SPI_RAM_SIZE;
+    }
+    if (us <= SPI_BUS_SETUP_US){
+        return 0;
+    }
+    // the same sum as spi_bus_xfer_us, backwards, less the 3 byte header
+    uint64_t bytes = (uint64_t)(us - SPI_BUS_SETUP_US) * RAM_BAUD / 8 / 1000000;
+    return bytes > 3 ? bytes - 3 : 0;
+}
+
+// 32 bit words go out MSB first, byte swap a chunk at a time and send each chunk as
+// its own bus transaction so other devices get a look in on long transfers
+static bool write_words(uint16_t addr, const uint32_t *w, size_t n){
+    uint8_t buf[CHUNK_WORDS * 4];
+    while (n > 0){
+        size_t chunk = n < CHUNK_WORDS ? n : CHUNK_WORDS;
+        for (size_t i = 0; i < chunk; i++){
+            buf[4*i]     = (w[i]>>24) & 0xFF;
+            buf[4*i + 1] = (w[i]>>16) & 0xFF;
+            buf[4*i + 2] = (w[i]>>8) & 0xFF;
+            buf[4*i + 3] = w[i] & 0xFF;
+        }
+        if (!ram_transfer(RAM_WRITE, addr, buf, NULL, chunk * 4)){
+            return false;
+        }
+        addr += chunk * 4;
+        w += chunk;
+        n -= chunk;
+    }
+    return true;
+}
+
+static bool read_words(uint16_t addr, uint32_t *w, size_t n){
+    uint8_t buf[CHUNK_WORDS * 4];
+    while (n > 0){
+        size_t chunk = n < CHUNK_WORDS ? n : CHUNK_WORDS;
+        if (!ram_transfer(RAM_READ, addr, NULL, buf, chunk * 4)){
+            return false;
+        }
+        for (size_t i = 0; i < chunk; i++){
+            w[i] = ((uint32_t)buf[4*i] << 24) |
+                   ((uint32_t)buf[4*i + 1] << 16) |
+                   ((uint32_t)buf[4*i + 2] << 8)  |
+                   ((uint32_t)buf[4*i + 3]);
+        }
+        addr += chunk * 4;
+        w += chunk;
+        n -= chunk;
+    }
+    return true;
+}
+
+bool spi_ram_write_floats(uint16_t addr, const float *v, size_t n){
+    return write_words(addr, (const uint32_t *)v, n);
+}
+
+bool spi_ram_read_floats(uint16_t addr, float *v, size_t n){
+    return read_words(addr, (uint32_t *)v, n);
+}
+
+bool spi_ram_write_ints(uint16_t addr, const int32_t *v, size_t n){
+    return write_words(addr, (const uint32_t *)v, n);
+}
+
+bool spi_ram_read_ints(uint16_t addr, int32_t *v, size_t n){
+    return read_words(addr, (uint32_t *)v, n);
+}
+
+#define BENCH_MAX 1024
+
+void spi_ram_benchmark(uint n){
+    static float out[BENCH_MAX];
+    static float in[BENCH_MAX];
+    if (n > BENCH_MAX){
+        n = BENCH_MAX;
+    }
+    for (uint i = 0; i < n; i++){
+        out[i] = (float)i * 0.5f;
+    }
+
+    bool ok = true;
+    uint64_t t0 = time_us_64();
+    for (uint i = 0; i < n && ok; i++){
+        ok = spi_ram_write(i * 4, out[i]);
+    }
+    uint64_t t1 = time_us_64();
+    for (uint i = 0; i < n && ok; i++){
+        ok = spi_ram_read(i * 4, &in[i]);
+    }
+    uint64_t t2 = time_us_64();
+    ok = ok && spi_ram_write_floats(0, out, n);
+    uint64_t t3 = time_us_64();
+    ok = ok && spi_ram_read_floats(0, in, n);
+    uint64_t t4 = time_us_64();
+    if (!ok){
+        printf("SPI RAM benchmark: the bus is claimed, stop playback first\n");
+        return;
+    }
+
+    int errors = 0;
+    for (uint i = 0; i < n; i++){
+        if (in[i] != out[i]){
+            errors++;
+        }
+    }
+
+    uint bytes = n * 4;
+    printf("SPI RAM, %u floats at %u Hz SPI\n", n, RAM_BAUD);
+    printf("%-14s %10s %10s\n", "", "us", "KB/s");
+    printf("%-14s %10llu %10llu\n", "write float", t1 - t0, bytes * 1000ull / (t1 - t0));
+    printf("%-14s %10llu %10llu\n", "read float", t2 - t1, bytes * 1000ull / (t2 - t1));
+    printf("%-14s %10llu %10llu\n", "write block", t3 - t2, bytes * 1000ull / (t3 - t2));
+    printf("%-14s %10llu %10llu\n", "read block", t4 - t3, bytes * 1000ull / (t4 - t3));
+    printf("readback errors: %d\n", errors);
+}
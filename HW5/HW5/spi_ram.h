@@ -0,0 +1,51 @@
+#ifndef SPI_RAM_H__
+#define SPI_RAM_H__
+
+#include "pico/stdlib.h"
+#include "hardware/spi.h"
+#include "spi_bus.h"
+
+// 23K256 32KB SPI SRAM, a device on the spi0 bus shared with the DAC
+#define RAM_SPI      spi0
+#define RAM_CS       13
+#define RAM_BAUD     (10*1000*1000)
+#define SPI_RAM_SIZE 0x8000
+
+union FloatInt {
+    float f;
+    uint32_t i;
+};
+
+// register with the bus (spi_bus_init first) and put the RAM in sequential mode
+void spi_ram_init();
+// false if the bus is claimed and won't lend a gap for it (see below)
+bool spi_ram_write(uint16_t addr, float v);
+bool spi_ram_read(uint16_t address, float *v);
+
+// burst access, one bus transaction for the whole buffer.
+// the RAM is in sequential mode so the address auto increments (and wraps at 32KB).
+// false if DAC playback or a stream holds the bus and the burst is too long for
+// the gaps it lends (see spi_bus.h)
+bool spi_ram_write_block(uint16_t addr, const uint8_t *buf, size_t len);
+bool spi_ram_read_block(uint16_t addr, uint8_t *buf, size_t len);
+// queue a block write and return straight away, buf must stay put until
+// xfer->complete (or the done callback). Safe to call while the bus is claimed,
+// it goes out in a gap the holder lends if it fits
+void spi_ram_submit_write(spi_xfer_t *xfer, uint16_t addr, const uint8_t *buf, size_t len,
+                          spi_xfer_cb_t done);
+// the biggest block transfer the bus can take right now, 0 while the holder
+// has no gaps to lend
+size_t spi_ram_max_burst(void);
+
+// typed arrays, stored MSB first like spi_ram_write so the two can be mixed.
+// these go in 256 byte transactions and stop at the first one the bus refuses,
+// returning false with only the chunks before it done
+bool spi_ram_write_floats(uint16_t addr, const float *v, size_t n);
+bool spi_ram_read_floats(uint16_t addr, float *v, size_t n);
+bool spi_ram_write_ints(uint16_t addr, const int32_t *v, size_t n);
+bool spi_ram_read_ints(uint16_t addr, int32_t *v, size_t n);
+
+// time n floats through the per value calls and the burst calls, prints the results
+void spi_ram_benchmark(uint n);
+
+#endif
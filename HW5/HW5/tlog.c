@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <string.h>
+#include "tlog.h"
+#include "spi_ram.h"
+#include "pico/stdio_usb.h"
+#include "hardware/sync.h"
+
+#define STAGE_MASK (TLOG_STAGE - 1)
+#define DUMP_RECORDS 16 // records read from the chip per dump chunk
+
+_Static_assert(sizeof(tlog_record_t) == 16, "records are packed into 16 bytes");
+_Static_assert((TLOG_STAGE & STAGE_MASK) == 0, "TLOG_STAGE must be a power of 2");
+_Static_assert(TLOG_BASE + TLOG_BYTES <= SPI_RAM_SIZE, "log doesn't fit in the RAM");
+
+typedef enum {
+    TLOG_IDLE,
+    TLOG_RUNNING,
+    TLOG_TRIGGERED, // counting down to the freeze
+    TLOG_FROZEN
+} tlog_state_t;
+
+static tlog_record_t stage[TLOG_STAGE];
+static volatile uint32_t head = 0; // next slot to fill, only the producer writes it
+static volatile uint32_t tail = 0; // next slot to drain, only the consumer writes it
+static volatile tlog_state_t state = TLOG_IDLE;
+static volatile uint32_t post_left;
+static uint8_t seq = 0;
+
+static spi_xfer_t xfer;
+static uint32_t in_flight = 0; // records in the burst on the bus
+static uint32_t written = 0;   // records ever written, the slot is written % TLOG_RECORDS
+static tlog_stats_t stats;
+
+void tlog_init(void){
+    state = TLOG_IDLE;
+    head = 0;
+    tail = 0;
+    in_flight = 0;
+    written = 0;
+    stats = (tlog_stats_t){0};
+}
+
+bool tlog_append(uint8_t source, const int16_t *v, uint n){
+    tlog_state_t s = state;
+    if (s == TLOG_IDLE || s == TLOG_FROZEN){
+        return false;
+    }
+
+    uint32_t h = head;
+    if (h - tail >= TLOG_STAGE){
+        stats.dropped++;
+        seq++;
+        return false;
+    }
+
+    tlog_record_t *r = &stage[h & STAGE_MASK];
+    r->time_us = time_us_32();
+    r->source = source;
+    r->seq = seq++;
+    for (uint i = 0; i < TLOG_VALUES; i++){
+        r->v[i] = i < n ? v[i] : 0;
+    }
+    // the record has to be in memory before the consumer can see it
+    __dmb();
+    head = h + 1;
+    stats.appended++;
+
+    if (s == TLOG_TRIGGERED && --post_left == 0){
+        state = TLOG_FROZEN;
+    }
+    return true;
+}
+
+void tlog_poll(void){
+    if (in_flight){
+        if (!xfer.complete){
+            return;
+        }
+        tail += in_flight;
+        written += in_flight;
+        stats.written += in_flight;
+        in_flight = 0;
+    }
+
+    uint32_t n = head - tail;
+    __dmb();
+    if (n == 0){
+        return;
+    }
+    if (n > stats.max_staged){
+        stats.max_staged = n;
+    }
+
+    // one burst can't run off the end of the staging ring or the log
+    uint32_t first = tail & STAGE_MASK;
+    uint32_t slot = written % TLOG_RECORDS;
+    if (n > TLOG_STAGE - first){
+        n = TLOG_STAGE - first;
+    }
+    if (n > TLOG_RECORDS - slot){
+        n = TLOG_RECORDS - slot;
+    }
+    if (n > TLOG_BATCH){
+        n = TLOG_BATCH;
+    }
+    // no bigger than the gaps playback lends, or it would wait for it to stop
+    uint32_t fit = spi_ram_max_burst() / sizeof(tlog_record_t);
+    if (fit == 0){
+        return;
+    }
+    if (n > fit){
+        n = fit;
+    }
+
+    in_flight = n;
+    stats.batches++;
+    spi_ram_submit_write(&xfer, TLOG_BASE + slot * sizeof(tlog_record_t),
+                         (const uint8_t *)&stage[first], n * sizeof(tlog_record_t), NULL);
+}
+
+void tlog_arm(void){
+    state = TLOG_IDLE;
+    // let the last burst land before the indexes move
+    while (in_flight){
+        tlog_poll();
+    }
+    uint32_t save = save_and_disable_interrupts();
+    head = 0;
+    tail = 0;
+    written = 0;
+    stats = (tlog_stats_t){0};
+    state = TLOG_RUNNING;
+    restore_interrupts(save);
+}
+
+void tlog_trigger(uint post){
+    if (state != TLOG_RUNNING){
+        return;
+    }
+    if (post == 0){
+        state = TLOG_FROZEN;
+        return;
+    }
+    post_left = post;
+    state = TLOG_TRIGGERED;
+}
+
+bool tlog_frozen(void){
+    return state == TLOG_FROZEN && head == tail && !in_flight;
+}
+
+bool tlog_dump(void){
+    if (state == TLOG_IDLE){
+        return false;
+    }
+    // now, even part way through a trigger's countdown
+    state = TLOG_FROZEN;
+    while (!tlog_frozen()){
+        tlog_poll();
+    }
+
+    uint32_t count = written < TLOG_RECORDS ? written : TLOG_RECORDS;
+    uint32_t index = written - count; // oldest record still in the log
+
+    uint8_t header[8] = {'T', 'L', 'O', 'G'};
+    header[4] = sizeof(tlog_record_t) & 0xFF;
+    header[5] = sizeof(tlog_record_t) >> 8;
+    header[6] = count & 0xFF;
+    header[7] = count >> 8;
+
+    // raw bytes, skip stdio so nothing gets \r\n translated
+    stdio_flush();
+    stdio_usb.out_chars((const char *)header, sizeof(header));
+
+    static tlog_record_t chunk[DUMP_RECORDS];
+    while (count > 0){
+        uint32_t slot = index % TLOG_RECORDS;
+        uint32_t n = count < DUMP_RECORDS ? count : DUMP_RECORDS;
+        if (n > TLOG_RECORDS - slot){
+            n = TLOG_RECORDS - slot;
+        }
+        // a trigger can start playback part way, then read what fits its gaps
+        // and try again until the bus lets us
+        uint32_t fit = spi_ram_max_burst() / sizeof(tlog_record_t);
+        if (n > fit){
+            n = fit;
+        }
+        if (n == 0 || !spi_ram_read_block(TLOG_BASE + slot * sizeof(tlog_record_t), (uint8_t *)chunk,
+                                          n * sizeof(tlog_record_t))){
+            tight_loop_contents();
+            continue;
+        }
+        stdio_usb.out_chars((const char *)chunk, n * sizeof(tlog_record_t));
+        index += n;
+        count -= n;
+    }
+    return true;
+}
+
+void tlog_get_stats(tlog_stats_t *s){
+    *s = stats;
+}
@@ -0,0 +1,66 @@
+#ifndef TLOG_H__
+#define TLOG_H__
+
+#include "pico/stdlib.h"
+
+// Circular telemetry log in the upper half of the 23K256.
+// Producers (an IRQ or one core) append fixed size timestamped records to a
+// lock-free single producer / single consumer staging ring on chip; tlog_poll()
+// drains the ring in batches with queued burst writes, so neither side ever
+// waits on the SPI bus. The log wraps, keeping the newest TLOG_RECORDS records.
+// tlog_trigger() freezes it a set number of records after a fault so the lead
+// up can be dumped over USB with tlog_dump(). Nothing else writes from
+// TLOG_BASE up: the AWG's save/load and the cache benchmark stay below it.
+//
+// Batches are queued on the shared bus, so with a waveform playing they go out
+// in the gaps it lends between DAC frames (see spi_bus.h), cut down to fit: a
+// record is ~13us at 10MHz. A RAM stream at its top rate has no spare time,
+// then they wait and the staging ring overflows (counted as dropped).
+
+#define TLOG_BASE    0x4000
+#define TLOG_BYTES   0x4000
+#define TLOG_STAGE   64 // records staged on chip, power of 2
+#define TLOG_BATCH   32 // most records per burst write
+#define TLOG_VALUES  5
+
+// record sources
+#define TLOG_ADC   0
+#define TLOG_IMU   1
+#define TLOG_MOTOR 2
+
+typedef struct {
+    uint32_t time_us;
+    uint8_t source;
+    uint8_t seq; // counts every append, a gap in a dump means dropped records
+    int16_t v[TLOG_VALUES];
+} tlog_record_t;
+
+#define TLOG_RECORDS (TLOG_BYTES / sizeof(tlog_record_t))
+
+typedef struct {
+    uint32_t appended;
+    uint32_t dropped;   // staging ring was full
+    uint32_t written;   // records that reached the chip
+    uint32_t batches;   // burst writes
+    uint max_staged;    // deepest the staging ring has been
+} tlog_stats_t;
+
+void tlog_init(void);
+// clear the log and start recording
+void tlog_arm(void);
+// stamp and stage a record with up to TLOG_VALUES values, false if it was dropped
+// or the log is frozen. Safe from an IRQ
+bool tlog_append(uint8_t source, const int16_t *v, uint n);
+// move staged records to the chip, call this from the main loop
+void tlog_poll(void);
+// keep recording for post more records then freeze, 0 freezes now
+void tlog_trigger(uint post);
+// frozen and every staged record is on the chip
+bool tlog_frozen(void);
+// freeze the log and write it to USB, oldest record first, as "TLOG", uint16
+// record size, uint16 record count then the raw little endian records. Waits for
+// the bus. false (and nothing written) if the log was never armed
+bool tlog_dump(void);
+void tlog_get_stats(tlog_stats_t *stats);
+
+#endif
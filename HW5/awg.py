@@ -0,0 +1,52 @@
+
+# sudo apt-get install python3-pip
+# python3 -m pip install pyserial numpy
+
+# Upload a waveform table to the HW5 AWG and play it.
+# usage: python3 awg.py [port]
+
+import sys
+import struct
+import numpy as np
+import serial
+
+port = sys.argv[1] if len(sys.argv) > 1 else 'COM4'
+ser = serial.Serial(port, timeout=2)
+print('Opening port: ')
+print(ser.name)
+
+def command(cmd):
+    ser.write((cmd + '\n').encode())
+    reply = ser.read_until(b'\n').decode().strip()
+    print(cmd + ' -> ' + reply)
+    return reply
+
+def upload(slot, codes):
+    codes = np.clip(np.asarray(codes), 0, 1023).astype(np.uint16)
+    if command('upload %d %d' % (slot, len(codes))) != 'ready':
+        return False
+    ser.write(struct.pack('<%dH' % len(codes), *codes))
+    print(ser.read_until(b'\n').decode().strip())
+    return True
+
+n = 256
+t = np.arange(n) / n
+
+# slot 0: sine, slot 1: square, slot 2: ramp, slot 3: a 5 cycle chirp
+upload(0, 511.5 + 511.5 * np.sin(2 * np.pi * t))
+upload(1, np.where(t < 0.5, 1023, 0))
+upload(2, 1023 * t)
+upload(3, 511.5 + 511.5 * np.sin(2 * np.pi * 5 * t * t))
+
+# 256 samples at 25.6kHz -> 100Hz sine on channel A
+command('play 0 0 25600 loop')
+
+has_quit = False
+while not has_quit:
+    selection = input('\nENTER COMMAND: ')
+    if selection == 'q':
+        has_quit = True
+    else:
+        command(selection)
+
+ser.close()
@@ -0,0 +1,45 @@
+
+# sudo apt-get install python3-pip
+# python3 -m pip install pyserial
+
+# Freeze the HW5 telemetry log and save it as a csv.
+# usage: python3 tlog_dump.py [port] [file.csv]
+
+import sys
+import struct
+import serial
+
+port = sys.argv[1] if len(sys.argv) > 1 else 'COM4'
+out = sys.argv[2] if len(sys.argv) > 2 else 'tlog.csv'
+ser = serial.Serial(port, timeout=2)
+print('Opening port: ')
+print(ser.name)
+
+sources = {0: 'adc', 1: 'imu', 2: 'motor'}
+
+ser.reset_input_buffer()
+ser.write(b'log dump\n')
+
+# skip any text until the header
+ser.read_until(b'TLOG')
+size, count = struct.unpack('<HH', ser.read(4))
+print('%d records of %d bytes' % (count, size))
+
+data = ser.read(size * count)
+if len(data) != size * count:
+    print('short read, got %d of %d bytes' % (len(data), size * count))
+print(ser.read_until(b'\n').decode().strip())
+
+gaps = 0
+last_seq = None
+with open(out, 'w') as f:
+    f.write('time_us,source,seq,v0,v1,v2,v3,v4\n')
+    for i in range(len(data) // size):
+        t, src, seq, *v = struct.unpack('<IBB5h', data[i*size:(i+1)*size])
+        if last_seq is not None and seq != (last_seq + 1) & 0xFF:
+            gaps += 1
+        last_seq = seq
+        f.write('%d,%s,%d,%s\n' % (t, sources.get(src, src), seq, ','.join(str(x) for x in v)))
+
+print('wrote %s, %d gaps from dropped records' % (out, gaps))
+ser.close()
@@ -1,6 +1,8 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "hardware/i2c.h"
+#include "mcp23008.h"
+#include "i2c_bus.h"
 
 // I2C defines
 // This example will use I2C0 on GPIO8 (SDA) and GPIO9 (SCL) running at 400KHz.
@@ -8,15 +10,13 @@
 #define I2C_PORT i2c0
 #define I2C_SDA 8
 #define I2C_SCL 9
-#define READ_ADDR 0b0100000
-#define WR_ADDR 0b0100000
-#define GPIO_REG 0b00001001
-#define OLAT_REG 0b00001010
-#define IODIR_REG 0b00000000
+#define EXP_ADDR 0b0100000
+#define EXP_INT_PIN 10 // expander INT, open drain so the Pico pulls it up
+#define BUTTON_PIN 0   // expander pins
+#define LED_PIN 7
+#define BLINK_MS 100
+#define STATS_MS 5000
 
-void expander_init();
-void setPin(unsigned char address, unsigned char reg, unsigned char value);
-unsigned char readPin(unsigned char address, unsigned char reg);
 int pico_led_init(void);
 void pico_set_led(bool led_on);
 
@@ -35,57 +35,41 @@ int main()
     pico_led_init();
     pico_set_led(true);
 
-    expander_init();
+    i2c_bus_init(I2C_PORT, 400*1000);
+    mcp23008_init(I2C_PORT, EXP_ADDR, EXP_INT_PIN);
+    mcp23008_set_direction((uint8_t)~(1 << LED_PIN));
+    mcp23008_set_pin(LED_PIN, !(mcp23008_inputs() & (1 << BUTTON_PIN)));
 
     // For more examples of I2C use see https://github.com/raspberrypi/pico-examples/tree/master/i2c
 
-    unsigned char IOstates;
+    absolute_time_t nextBlink = make_timeout_time_ms(BLINK_MS);
+    absolute_time_t nextStats = make_timeout_time_ms(STATS_MS);
 
     while (true) {
 
-        IOstates = readPin(READ_ADDR, GPIO_REG);
-
-        if (!(IOstates & 0b1)){
-            //set GP0 high (turn on LED)
-            setPin(WR_ADDR, OLAT_REG, 0b10000000);
-        }
-        else {
-            //set GP0 low (turn off LED)
-            setPin(WR_ADDR, OLAT_REG, 0b00000000);
+        // the expander is only read when its INT says an input moved
+        if (mcp23008_task() && (mcp23008_changed() & (1 << BUTTON_PIN))){
+            // button pulls GP0 low, LED on GP7 follows it
+            bool pressed = !(mcp23008_inputs() & (1 << BUTTON_PIN));
+            mcp23008_set_pin(LED_PIN, pressed);
         }
 
-        sleep_ms(100);
-
-        if (gpio_get(PICO_DEFAULT_LED_PIN)){
-            pico_set_led(false);
+        if (time_reached(nextBlink)){
+            nextBlink = delayed_by_us(nextBlink, BLINK_MS * 1000);
+            pico_set_led(!gpio_get(PICO_DEFAULT_LED_PIN));
         }
-        else {
-            pico_set_led(true);
+
+        if (time_reached(nextStats)){
+            nextStats = delayed_by_us(nextStats, STATS_MS * 1000);
+            mcp23008_stats_t st;
+            mcp23008_get_stats(&st);
+            printf("I2C transactions: %lu, INT edges: %lu, input changes: %lu\n",
+                   (unsigned long)st.transactions, (unsigned long)st.interrupts,
+                   (unsigned long)st.changes);
         }
-    
     }
 }
 
-void expander_init(){
-    unsigned char IODirections = 0b01111111;
-    setPin(WR_ADDR, IODIR_REG, IODirections);
-}
-
-void setPin(unsigned char address, unsigned char reg, unsigned char value) {
-    unsigned char buf[2];
-    buf[0] = reg;
-    buf[1] = value;
-    i2c_write_blocking(i2c_default, address, buf, 2, false);
-
-}
-
-unsigned char readPin(unsigned char address, unsigned char reg){
-    unsigned char buf;
-    i2c_write_blocking(i2c_default, address, &reg, 1, true);  // true to keep master control of bus
-    i2c_read_blocking(i2c_default, address, &buf, 1, false);  // false - finished with bus
-    return buf;
-}
-
 int pico_led_init(void) {
 #if defined(PICO_DEFAULT_LED_PIN)
     // A device like Pico that uses a GPIO for the LED will define PICO_DEFAULT_LED_PIN
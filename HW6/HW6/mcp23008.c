@@ -0,0 +1,176 @@
+#include "mcp23008.h"
+#include "i2c_bus.h"
+
+#define IOCON_SEQOP (1 << 5) // 1 disables the address pointer increment
+#define IOCON_ODR   (1 << 2) // open drain INT
+
+#define CONFIG_REGS (MCP_GPPU + 1) // IODIR..GPPU are all writable, sent as one run
+
+static i2c_inst_t *bus;
+static uint8_t address;
+static uint intPin;
+
+static uint8_t shadow[CONFIG_REGS];
+static uint8_t olat;
+static uint8_t dirty = 0; // bit per config register
+static bool olatDirty = false;
+static int batching = 0;
+
+static volatile bool pending = false;
+static uint8_t inputs = 0;
+static uint8_t changed = 0;
+static mcp23008_stats_t stats;
+
+static void write_regs(uint8_t reg, const uint8_t *values, uint n){
+    uint8_t buf[CONFIG_REGS + 1];
+    buf[0] = reg;
+    for (uint i = 0; i < n; i++){
+        buf[i + 1] = values[i];
+    }
+    i2c_bus_write(bus, address, buf, n + 1);
+    stats.transactions++;
+}
+
+static void read_regs(uint8_t reg, uint8_t *values, uint n){
+    i2c_bus_read_reg(bus, address, reg, values, n);
+    stats.transactions++;
+}
+
+// write out whatever changed, the dirty config registers as one sequential run
+static void flush(){
+    if (dirty){
+        uint lo = 0;
+        uint hi = CONFIG_REGS - 1;
+        while (!(dirty & (1 << lo))){
+            lo++;
+        }
+        while (!(dirty & (1 << hi))){
+            hi--;
+        }
+        write_regs(lo, &shadow[lo], hi - lo + 1);
+        dirty = 0;
+    }
+    if (olatDirty){
+        write_regs(MCP_OLAT, &olat, 1);
+        olatDirty = false;
+    }
+}
+
+static void set_reg(uint8_t reg, uint8_t value){
+    if (shadow[reg] != value){
+        shadow[reg] = value;
+        dirty |= 1 << reg;
+    }
+    if (!batching){
+        flush();
+    }
+}
+
+static void int_callback(uint gpio, uint32_t events){
+    if (gpio == intPin){
+        pending = true;
+        stats.interrupts++;
+    }
+}
+
+void mcp23008_init(i2c_inst_t *i2c, uint8_t addr, uint int_pin){
+    bus = i2c;
+    address = addr;
+    intPin = int_pin;
+
+    // power on state, except INT is open drain so it can share a pulled up line
+    shadow[MCP_IODIR] = 0xFF;
+    shadow[MCP_IPOL] = 0x00;
+    shadow[MCP_GPINTEN] = 0x00;
+    shadow[MCP_DEFVAL] = 0x00;
+    shadow[MCP_INTCON] = 0x00; // compare against the previous value
+    shadow[MCP_IOCON] = IOCON_ODR & ~IOCON_SEQOP; // the batched runs need the pointer to step
+    shadow[MCP_GPPU] = 0x00;
+    olat = 0x00;
+    // IOCON on its own first: a Pico reset doesn't reset the chip, which could
+    // still have SEQOP set and would take the whole run below into IODIR
+    write_regs(MCP_IOCON, &shadow[MCP_IOCON], 1);
+    write_regs(MCP_IODIR, shadow, CONFIG_REGS);
+    write_regs(MCP_OLAT, &olat, 1);
+
+    read_regs(MCP_GPIO, &inputs, 1);
+
+    gpio_init(intPin);
+    gpio_set_dir(intPin, GPIO_IN);
+    gpio_pull_up(intPin);
+    gpio_set_irq_enabled_with_callback(intPin, GPIO_IRQ_EDGE_FALL, true, &int_callback);
+}
+
+void mcp23008_set_direction(uint8_t in){
+    mcp23008_begin();
+    set_reg(MCP_IODIR, in);
+    set_reg(MCP_GPINTEN, in);
+    mcp23008_commit();
+}
+
+void mcp23008_set_pullups(uint8_t mask){
+    set_reg(MCP_GPPU, mask);
+}
+
+void mcp23008_write_mask(uint8_t mask, uint8_t values){
+    uint8_t next = (olat & ~mask) | (values & mask);
+    if (next != olat){
+        olat = next;
+        olatDirty = true;
+    }
+    if (!batching){
+        flush();
+    }
+}
+
+void mcp23008_set_pin(uint pin, bool value){
+    mcp23008_write_mask(1 << pin, value ? 1 << pin : 0);
+}
+
+void mcp23008_begin(void){
+    batching++;
+}
+
+void mcp23008_commit(void){
+    if (batching > 0){
+        batching--;
+    }
+    if (!batching){
+        flush();
+    }
+}
+
+bool mcp23008_task(void){
+    if (!pending){
+        return false;
+    }
+    pending = false;
+
+    // reading GPIO also clears the interrupt
+    uint8_t now;
+    read_regs(MCP_GPIO, &now, 1);
+    // another change can land before the read, INT is still low then
+    if (!gpio_get(intPin)){
+        pending = true;
+    }
+
+    changed = (now ^ inputs) & shadow[MCP_IODIR];
+    inputs = now;
+    if (changed){
+        stats.changes++;
+        return true;
+    }
+    return false;
+}
+
+uint8_t mcp23008_inputs(void){
+    return inputs;
+}
+
+uint8_t mcp23008_changed(void){
+    return changed;
+}
+
+void mcp23008_get_stats(mcp23008_stats_t *s){
+    *s = stats;
+}
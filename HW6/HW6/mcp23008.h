@@ -0,0 +1,59 @@
+#ifndef MCP23008_H__
+#define MCP23008_H__
+
+#include "pico/stdlib.h"
+#include "hardware/i2c.h"
+
+// MCP23008 8 bit I2C port expander.
+// The driver keeps a shadow of IODIR, GPPU, GPINTEN and OLAT, so setting or
+// clearing a pin never needs a read back, and only touches the bus when a register
+// actually changes. Between mcp23008_begin() and mcp23008_commit() pin writes only
+// go to the shadow and the whole batch goes out as one transaction.
+//
+// Inputs use interrupt-on-change: the INT output (open drain, active low) is wired
+// to a Pico GPIO, the IRQ just flags it and mcp23008_task() reads GPIO once per change.
+
+// registers
+#define MCP_IODIR   0x00
+#define MCP_IPOL    0x01
+#define MCP_GPINTEN 0x02
+#define MCP_DEFVAL  0x03
+#define MCP_INTCON  0x04
+#define MCP_IOCON   0x05
+#define MCP_GPPU    0x06
+#define MCP_INTF    0x07
+#define MCP_INTCAP  0x08
+#define MCP_GPIO    0x09
+#define MCP_OLAT    0x0A
+
+typedef struct {
+    uint32_t transactions; // I2C transactions started
+    uint32_t interrupts;   // INT falling edges
+    uint32_t changes;      // reads that found an input had changed
+} mcp23008_stats_t;
+
+// every pin starts as an input with no pull-up. i2c_bus_init(i2c) first
+void mcp23008_init(i2c_inst_t *i2c, uint8_t addr, uint int_pin);
+
+// 1 bits are inputs, inputs also get interrupt-on-change
+void mcp23008_set_direction(uint8_t inputs);
+void mcp23008_set_pullups(uint8_t mask);
+
+void mcp23008_set_pin(uint pin, bool value);
+// set the pins in mask to the matching bits of values
+void mcp23008_write_mask(uint8_t mask, uint8_t values);
+
+// hold register writes in the shadow until commit
+void mcp23008_begin(void);
+void mcp23008_commit(void);
+
+// read the inputs if INT fired, true when any input changed. Call from the main loop
+bool mcp23008_task(void);
+// last input state read, no bus traffic
+uint8_t mcp23008_inputs(void);
+// pins that changed on the last mcp23008_task() that returned true
+uint8_t mcp23008_changed(void);
+
+void mcp23008_get_stats(mcp23008_stats_t *stats);
+
+#endif
@@ -5,6 +5,7 @@
 #include "hardware/gpio.h"
 
 #include "ssd1306.h"
+#include "i2c_bus.h"
 #include "font.h"
 
 // I2C defines
@@ -40,7 +41,11 @@ int main()
     pico_led_init();
     pico_set_led(true);
 
-    ssd1306_setup();
+    // the OLED frames go out from the I2C interrupt
+    i2c_bus_init(I2C_PORT, 400*1000);
+    ssd1306_setup(I2C_PORT);
+    // run the display as fast as it and the pull-ups allow, up to 1MHz
+    printf("OLED at %u Hz\n", ssd1306_probe_speed(50));
 
     // For more examples of I2C use see https://github.com/raspberrypi/pico-examples/tree/master/i2c
 
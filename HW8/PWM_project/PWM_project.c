@@ -1,74 +1,51 @@
 #include <stdio.h>
 #include "pico/stdlib.h"
 #include "hardware/pwm.h"
+#include "servo.h"
+#include "motion.h"
 
 
 #define SERVO_PIN 21 // the built in LED on the Pico
-#define WRAP 30000
+
+// every servo on the robot, add pins here (up to SERVO_MAX)
+static const uint servoPins[] = {SERVO_PIN};
+#define NUM_SERVOS (sizeof(servoPins) / sizeof(servoPins[0]))
+
+#define SWEEP_SPEED 360  // deg/s
+#define SWEEP_ACCEL 1440 // deg/s^2
 
 void PWM_init();
-void set_angle(float angle);
 
 
 int main()
 {
     stdio_init_all();
 
-    gpio_set_function(SERVO_PIN, GPIO_FUNC_PWM); // Set the LED Pin to be PWM
-
     PWM_init();
 
-    int servoAngle = 0;
     bool incline = true;
+    motion_profile_t profile = MOTION_TRAPEZOID;
 
-
+    // the wrap interrupt walks each servo to its target, the loop only hands out
+    // new targets once the last ones are reached
     while (true) {
-        // pwm_set_gpio_level(SERVO_PIN, (uint16_t)(WRAP * 0.05));
-        // set_angle(90);
-
-        // sleep_ms(1000);
-
-        // pwm_set_gpio_level(SERVO_PIN, (uint16_t)(WRAP * 0.06));
-        // set_angle(100);
-
-        // sleep_ms(1000);
-
-        if (incline){
-            servoAngle += 10;
-            if (servoAngle > 180){
-                incline = false;
-                servoAngle -= 20;
+        if (motion_idle()){
+            for (uint i = 0; i < NUM_SERVOS; i++){
+                motion_move_angle(i, incline ? 180 : 0, SWEEP_SPEED, SWEEP_ACCEL, profile);
             }
+            incline = !incline;
+            profile = (profile == MOTION_TRAPEZOID) ? MOTION_SCURVE : MOTION_TRAPEZOID;
         }
-        else {
-            servoAngle -= 10;
-            if (servoAngle < 0){
-                incline = true;
-                servoAngle += 20;
-            }
-        }
-        
-        set_angle(servoAngle);
-        sleep_ms(300);
+        tight_loop_contents();
     }
 }
 
 void PWM_init(){
-    uint slice_num = pwm_gpio_to_slice_num(SERVO_PIN); // Get PWM slice number
-    float div = 100; // must be between 1-255
-    pwm_set_clkdiv(slice_num, div); // divider
-    //uint16_t wrap = 1000; // when to rollover, must be less than 65535
-    pwm_set_wrap(slice_num, (uint16_t)WRAP);
-    pwm_set_enabled(slice_num, true); // turn on the PWM
-    pwm_set_gpio_level(SERVO_PIN, (uint16_t)WRAP * 0.025); // set the duty cycle to 50%
-}
-
-void set_angle(float angle){
-    if (angle <= 180 && angle >= 0){
-        float duty_cycle = ((angle/180) * (0.125 - 0.025)) + 0.025;
-
-        uint16_t wrap = 1000;
-        pwm_set_gpio_level(SERVO_PIN, (uint16_t)(WRAP * duty_cycle));
+    for (uint i = 0; i < NUM_SERVOS; i++){
+        if (servo_attach(servoPins[i]) < 0){
+            printf("GP%u: PWM channel already taken\n", servoPins[i]);
+        }
     }
-
+    servo_start();
+    motion_init();
 }
@@ -0,0 +1,212 @@
+#include "motion.h"
+#include "hardware/sync.h"
+
+#define ONE (1 << 16) // 16.16 fixed point
+#define US_PER_DEGREE_Q16 (((SERVO_MAX_US - SERVO_MIN_US) * ONE) / 180)
+
+typedef struct {
+    bool moving;
+    motion_profile_t profile;
+    int32_t pos;    // us, 16.16
+    int32_t vel;    // us per tick, 16.16
+    int32_t target; // us, 16.16
+    int32_t vmax;   // us per tick, 16.16
+    int32_t amax;   // us per tick^2, 16.16
+    // s-curve
+    int32_t start;
+    uint32_t tick;
+    uint32_t duration; // ticks
+} axis_t;
+
+static axis_t axes[SERVO_MAX];
+
+static uint32_t isqrt64(uint64_t n){
+    uint64_t root = 0;
+    uint64_t bit = 1ull << 62;
+    while (bit > n){
+        bit >>= 2;
+    }
+    while (bit){
+        if (n >= root + bit){
+            n -= root + bit;
+            root = (root >> 1) + bit;
+        }
+        else {
+            root >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t)root;
+}
+
+static int32_t abs32(int32_t x){
+    return x < 0 ? -x : x;
+}
+
+// one tick of the trapezoid: brake if the stopping distance has run out,
+// otherwise speed up towards vmax in the direction of the target
+static void step_trapezoid(axis_t *a){
+    int32_t d = a->target - a->pos;
+    int32_t dir = d < 0 ? -1 : 1;
+    int64_t stopping = (int64_t)a->vel * a->vel / (2 * (int64_t)a->amax);
+
+    if (abs32(d) <= a->amax && abs32(a->vel) <= a->amax){
+        a->pos = a->target;
+        a->vel = 0;
+        a->moving = false;
+        return;
+    }
+
+    bool towards = (a->vel == 0) || ((a->vel < 0) == (d < 0));
+    if (towards && stopping < abs32(d)){
+        a->vel += dir * a->amax;
+        if (abs32(a->vel) > a->vmax){
+            a->vel = dir * a->vmax;
+        }
+    }
+    else {
+        // brake (or turn round), but not past zero in one step
+        if (abs32(a->vel) <= a->amax){
+            a->vel = towards ? dir * a->amax : 0;
+        }
+        else {
+            a->vel -= (a->vel < 0 ? -1 : 1) * a->amax;
+        }
+    }
+
+    // never step past the target
+    if (towards && abs32(a->vel) > abs32(d)){
+        a->vel = d;
+    }
+    a->pos += a->vel;
+}
+
+// 10u^3 - 15u^4 + 6u^5, u and the result in 16.16
+static int32_t min_jerk(int32_t u){
+    int64_t u2 = ((int64_t)u * u) >> 16;
+    int64_t u3 = (u2 * u) >> 16;
+    int64_t u4 = (u3 * u) >> 16;
+    int64_t u5 = (u4 * u) >> 16;
+    return (int32_t)(10 * u3 - 15 * u4 + 6 * u5);
+}
+
+static void step_scurve(axis_t *a){
+    a->tick++;
+    if (a->tick >= a->duration){
+        a->pos = a->target;
+        a->moving = false;
+        return;
+    }
+    int32_t u = (int32_t)(((uint64_t)a->tick << 16) / a->duration);
+    a->pos = a->start + (int32_t)(((int64_t)(a->target - a->start) * min_jerk(u)) >> 16);
+}
+
+// runs in the PWM wrap interrupt
+static void motion_tick(){
+    bool any = false;
+    for (uint i = 0; i < servo_count(); i++){
+        axis_t *a = &axes[i];
+        if (!a->moving){
+            continue;
+        }
+        if (a->profile == MOTION_SCURVE){
+            step_scurve(a);
+        }
+        else {
+            step_trapezoid(a);
+        }
+        servo_set_us_q16(i, a->pos);
+        any = true;
+    }
+    if (any){
+        servo_commit();
+    }
+}
+
+void motion_init(void){
+    for (uint i = 0; i < servo_count(); i++){
+        axes[i].moving = false;
+        axes[i].pos = servo_get_us(i) * ONE;
+        axes[i].vel = 0;
+    }
+    servo_set_tick_callback(motion_tick);
+}
+
+void motion_move_us(int servo, uint32_t target_us, uint32_t vmax, uint32_t amax, motion_profile_t profile){
+    if (servo < 0 || servo >= (int)servo_count() || vmax == 0 || amax == 0){
+        return;
+    }
+    if (target_us < SERVO_MIN_US){
+        target_us = SERVO_MIN_US;
+    }
+    if (target_us > SERVO_MAX_US){
+        target_us = SERVO_MAX_US;
+    }
+
+    // per second limits to per tick, the minimum step keeps slow moves moving
+    int32_t v = (int32_t)(((uint64_t)vmax << 16) / MOTION_TICK_HZ);
+    int32_t acc = (int32_t)(((uint64_t)amax << 16) / (MOTION_TICK_HZ * MOTION_TICK_HZ));
+    if (v < 1){
+        v = 1;
+    }
+    if (acc < 1){
+        acc = 1;
+    }
+
+    uint32_t save = save_and_disable_interrupts();
+    axis_t *a = &axes[servo];
+    a->target = (int32_t)target_us * ONE;
+    a->vmax = v;
+    a->amax = acc;
+    a->profile = profile;
+    if (profile == MOTION_SCURVE){
+        // peak speed is 1.875 d/T and peak acceleration 5.774 d/T^2
+        uint64_t d = abs32(a->target - a->pos);
+        uint32_t tv = (uint32_t)((d * 1875 / 1000 + v - 1) / v);
+        uint32_t ta = isqrt64((d * 5774 / 1000 + acc - 1) / acc) + 1;
+        a->duration = tv > ta ? tv : ta;
+        if (a->duration == 0){
+            a->duration = 1;
+        }
+        a->start = a->pos;
+        a->tick = 0;
+        a->vel = 0;
+    }
+    a->moving = true;
+    restore_interrupts(save);
+}
+
+void motion_move_angle(int servo, uint32_t degrees, uint32_t vmax, uint32_t amax, motion_profile_t profile){
+    if (degrees > 180){
+        degrees = 180;
+    }
+    uint32_t us = SERVO_MIN_US + (uint32_t)(((uint64_t)degrees * US_PER_DEGREE_Q16 + ONE / 2) >> 16);
+    motion_move_us(servo, us, (uint32_t)(((uint64_t)vmax * US_PER_DEGREE_Q16) >> 16),
+                   (uint32_t)(((uint64_t)amax * US_PER_DEGREE_Q16) >> 16), profile);
+}
+
+void motion_stop(int servo){
+    if (servo < 0 || servo >= (int)servo_count()){
+        return;
+    }
+    uint32_t save = save_and_disable_interrupts();
+    axes[servo].moving = false;
+    axes[servo].vel = 0;
+    restore_interrupts(save);
+}
+
+bool motion_busy(int servo){
+    if (servo < 0 || servo >= (int)servo_count()){
+        return false;
+    }
+    return axes[servo].moving;
+}
+
+bool motion_idle(void){
+    for (uint i = 0; i < servo_count(); i++){
+        if (axes[i].moving){
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef MOTION_H__
+#define MOTION_H__
+
+#include "pico/stdlib.h"
+#include "servo.h"
+
+// Servo trajectories worked out in the PWM wrap interrupt, once per 20ms period.
+// Positions are pulse widths in 16.16 fixed point microseconds.
+//   MOTION_TRAPEZOID  accelerate at amax up to vmax, cruise, brake at amax. Worked
+//                     out step by step, so a new target mid move is picked up smoothly
+//   MOTION_SCURVE     minimum jerk (quintic) curve, acceleration eases in and out.
+//                     The duration is picked so the peak speed and acceleration stay
+//                     inside vmax and amax. A new target restarts it from where it is
+// Nothing blocks: start a move and poll motion_busy() (or don't).
+
+#define MOTION_TICK_HZ (1000000 / SERVO_PERIOD_US)
+
+typedef enum {
+    MOTION_TRAPEZOID,
+    MOTION_SCURVE
+} motion_profile_t;
+
+// hook into the servo wrap interrupt, after the servos are attached
+void motion_init(void);
+
+// vmax in us/s, amax in us/s^2
+void motion_move_us(int servo, uint32_t target_us, uint32_t vmax, uint32_t amax, motion_profile_t profile);
+// the same in degrees, deg/s and deg/s^2
+void motion_move_angle(int servo, uint32_t degrees, uint32_t vmax, uint32_t amax, motion_profile_t profile);
+// stop where it is
+void motion_stop(int servo);
+
+bool motion_busy(int servo);
+// no servo is moving
+bool motion_idle(void);
+
+#endif
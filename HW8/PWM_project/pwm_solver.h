@@ -0,0 +1,60 @@
+#ifndef PWM_SOLVER_H__
+#define PWM_SOLVER_H__
+
+#include "pico/stdlib.h"
+
+// Works out a PWM slice's clock divider and wrap at compile time.
+// A period is sys_hz / freq_hz system clocks. The divider (8.4 fixed point,
+// 1 to 255 15/16) is kept as small as possible so the counter gets as many
+// counts per period as fit in 16 bits, which is the most duty cycle resolution
+// the clock allows. Above ~2.3kHz at 150MHz that is a divider of 1 and no
+// fractional jitter at all.
+//
+//   PWM_SOLVE(MOTOR_PWM, SYS_CLK_HZ, 20000, 1000);
+//
+// makes MOTOR_PWM_DIV_INT, MOTOR_PWM_DIV_FRAC, MOTOR_PWM_WRAP and MOTOR_PWM_TOP
+// (counts per period, wrap + 1, the level for 100%) and fails the build if the
+// frequency is out of reach, comes out more than 0.1% off, or gives fewer than
+// min_steps counts per period. Apply it with
+//
+//   pwm_set_clkdiv_int_frac(slice, MOTOR_PWM_DIV_INT, MOTOR_PWM_DIV_FRAC);
+//   pwm_set_wrap(slice, MOTOR_PWM_WRAP);
+//
+// SYS_CLK_HZ has to be what clk_sys really runs at.
+
+// system clocks per period, in 1/16ths to match the divider
+#define PWM_SOLVER_TICKS16(sys_hz, freq_hz) \
+    (((uint64_t)(sys_hz) * 16 + (uint64_t)(freq_hz) / 2) / (uint64_t)(freq_hz))
+
+// smallest divider that fits the period in 65536 counts
+#define PWM_SOLVER_DIV16(sys_hz, freq_hz) \
+    (PWM_SOLVER_TICKS16(sys_hz, freq_hz) <= 65536ull * 16 ? 16ull : \
+     (PWM_SOLVER_TICKS16(sys_hz, freq_hz) + 65535) / 65536)
+
+#define PWM_SOLVER_TOP(sys_hz, freq_hz) \
+    ((PWM_SOLVER_TICKS16(sys_hz, freq_hz) + PWM_SOLVER_DIV16(sys_hz, freq_hz) / 2) / \
+     PWM_SOLVER_DIV16(sys_hz, freq_hz))
+
+// how far the period we get is from the one asked for, in 1/16 system clocks
+#define PWM_SOLVER_ERROR16(sys_hz, freq_hz) \
+    (PWM_SOLVER_DIV16(sys_hz, freq_hz) * PWM_SOLVER_TOP(sys_hz, freq_hz) > PWM_SOLVER_TICKS16(sys_hz, freq_hz) ? \
+     PWM_SOLVER_DIV16(sys_hz, freq_hz) * PWM_SOLVER_TOP(sys_hz, freq_hz) - PWM_SOLVER_TICKS16(sys_hz, freq_hz) : \
+     PWM_SOLVER_TICKS16(sys_hz, freq_hz) - PWM_SOLVER_DIV16(sys_hz, freq_hz) * PWM_SOLVER_TOP(sys_hz, freq_hz))
+
+#define PWM_SOLVE(name, sys_hz, freq_hz, min_steps) \
+    _Static_assert((freq_hz) > 0 && (uint64_t)(freq_hz) * 2 <= (uint64_t)(sys_hz), \
+                   #name ": frequency too high, under two counts per period"); \
+    _Static_assert(PWM_SOLVER_DIV16(sys_hz, freq_hz) <= 255 * 16 + 15, \
+                   #name ": frequency too low even at the largest divider"); \
+    _Static_assert(PWM_SOLVER_TOP(sys_hz, freq_hz) >= (min_steps), \
+                   #name ": not enough counts per period for the resolution asked for"); \
+    _Static_assert(PWM_SOLVER_ERROR16(sys_hz, freq_hz) * 1000 <= PWM_SOLVER_TICKS16(sys_hz, freq_hz), \
+                   #name ": can't get within 0.1% of the frequency"); \
+    enum { \
+        name##_DIV_INT = (int)(PWM_SOLVER_DIV16(sys_hz, freq_hz) / 16), \
+        name##_DIV_FRAC = (int)(PWM_SOLVER_DIV16(sys_hz, freq_hz) % 16), \
+        name##_TOP = (int)PWM_SOLVER_TOP(sys_hz, freq_hz), \
+        name##_WRAP = (int)PWM_SOLVER_TOP(sys_hz, freq_hz) - 1 \
+    }
+
+#endif
@@ -0,0 +1,173 @@
+#include "servo.h"
+#include "hardware/pwm.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "pwm_solver.h"
+
+// 50Hz, and at least a count per microsecond
+PWM_SOLVE(SERVO_PWM, SYS_CLK_HZ, 1000000 / SERVO_PERIOD_US, SERVO_PERIOD_US);
+
+typedef struct {
+    uint gpio;
+    uint slice;
+    uint channel;
+} servo_t;
+
+static servo_t servos[SERVO_MAX];
+static uint numServos = 0;
+static uint32_t slicesUsed = 0;  // bit per slice
+static uint firstSlice;          // the slice that raises the wrap interrupt
+
+// levels in PWM counts
+static uint16_t staged[SERVO_MAX];   // what the caller is building
+static uint16_t committed[SERVO_MAX]; // waiting for the next wrap
+static uint16_t live[SERVO_MAX];     // going out now
+static volatile bool pending = false;
+static void (*tickCallback)(void) = NULL;
+
+static uint16_t us_to_counts(uint32_t us_q16){
+    return (uint16_t)(((uint64_t)us_q16 * SERVO_PWM_TOP + ((uint64_t)SERVO_PERIOD_US << 15)) /
+                      ((uint64_t)SERVO_PERIOD_US << 16));
+}
+
+static void wrap_handler(){
+    if (!(pwm_get_irq_status_mask() & (1u << firstSlice))){
+        return;
+    }
+    pwm_clear_irq(firstSlice);
+
+    if (tickCallback){
+        tickCallback();
+    }
+    if (!pending){
+        return;
+    }
+
+    // build both channels of each slice and write them as one word, the hardware
+    // latches CC at the next wrap so every slice switches together
+    uint32_t cc[NUM_PWM_SLICES] = {0};
+    for (uint i = 0; i < numServos; i++){
+        live[i] = committed[i];
+        cc[servos[i].slice] |= (uint32_t)live[i] << (servos[i].channel ? 16 : 0);
+    }
+    for (uint s = 0; s < NUM_PWM_SLICES; s++){
+        if (slicesUsed & (1u << s)){
+            pwm_hw->slice[s].cc = cc[s];
+        }
+    }
+    pending = false;
+}
+
+int servo_attach(uint gpio){
+    if (numServos >= SERVO_MAX){
+        return -1;
+    }
+    uint slice = pwm_gpio_to_slice_num(gpio);
+    uint channel = pwm_gpio_to_channel(gpio);
+    for (uint i = 0; i < numServos; i++){
+        if (servos[i].slice == slice && servos[i].channel == channel){
+            return -1;
+        }
+    }
+
+    if (!(slicesUsed & (1u << slice))){
+        pwm_set_enabled(slice, false);
+        pwm_set_clkdiv_int_frac(slice, SERVO_PWM_DIV_INT, SERVO_PWM_DIV_FRAC);
+        pwm_set_wrap(slice, SERVO_PWM_WRAP);
+        pwm_set_both_levels(slice, 0, 0);
+        if (!slicesUsed){
+            firstSlice = slice;
+        }
+        slicesUsed |= 1u << slice;
+    }
+
+    int n = numServos++;
+    servos[n].gpio = gpio;
+    servos[n].slice = slice;
+    servos[n].channel = channel;
+    // park in the middle until told otherwise
+    staged[n] = us_to_counts(((SERVO_MIN_US + SERVO_MAX_US) / 2) << 16);
+    committed[n] = staged[n];
+    pwm_set_chan_level(slice, channel, staged[n]);
+    live[n] = staged[n];
+    gpio_set_function(gpio, GPIO_FUNC_PWM);
+    return n;
+}
+
+void servo_start(void){
+    if (!slicesUsed){
+        return;
+    }
+    pwm_set_mask_enabled(pwm_hw->en & ~slicesUsed);
+    for (uint s = 0; s < NUM_PWM_SLICES; s++){
+        if (slicesUsed & (1u << s)){
+            pwm_set_counter(s, 0);
+        }
+    }
+
+    pwm_clear_irq(firstSlice);
+    pwm_set_irq_enabled(firstSlice, true);
+    irq_add_shared_handler(PWM_DEFAULT_IRQ_NUM(), wrap_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(PWM_DEFAULT_IRQ_NUM(), true);
+
+    // one write starts them all on the same clock
+    pwm_set_mask_enabled(pwm_hw->en | slicesUsed);
+}
+
+void servo_set_us_q16(int servo, uint32_t us_q16){
+    if (servo < 0 || servo >= (int)numServos){
+        return;
+    }
+    if (us_q16 < (SERVO_MIN_US << 16)){
+        us_q16 = SERVO_MIN_US << 16;
+    }
+    if (us_q16 > (SERVO_MAX_US << 16)){
+        us_q16 = SERVO_MAX_US << 16;
+    }
+    staged[servo] = us_to_counts(us_q16);
+}
+
+void servo_set_us(int servo, uint32_t us){
+    if (us > SERVO_MAX_US){
+        us = SERVO_MAX_US;
+    }
+    servo_set_us_q16(servo, us << 16);
+}
+
+void servo_set_angle(int servo, uint32_t degrees){
+    if (degrees > 180){
+        degrees = 180;
+    }
+    servo_set_us(servo, SERVO_MIN_US + (degrees * (SERVO_MAX_US - SERVO_MIN_US) + 90) / 180);
+}
+
+void servo_set_pose(const uint16_t *us, uint n){
+    for (uint i = 0; i < n && i < numServos; i++){
+        servo_set_us(i, us[i]);
+    }
+}
+
+void servo_commit(void){
+    // the wrap interrupt can't see a half copied pose
+    uint32_t save = save_and_disable_interrupts();
+    for (uint i = 0; i < numServos; i++){
+        committed[i] = staged[i];
+    }
+    pending = true;
+    restore_interrupts(save);
+}
+
+void servo_set_tick_callback(void (*cb)(void)){
+    tickCallback = cb;
+}
+
+uint servo_count(void){
+    return numServos;
+}
+
+uint32_t servo_get_us(int servo){
+    if (servo < 0 || servo >= (int)numServos){
+        return 0;
+    }
+    return ((uint32_t)live[servo] * SERVO_PERIOD_US + SERVO_PWM_TOP / 2) / SERVO_PWM_TOP;
+}
@@ -0,0 +1,45 @@
+#ifndef SERVO_H__
+#define SERVO_H__
+
+#include "pico/stdlib.h"
+
+// Up to 16 hobby servos on the PWM slices.
+// Every slice in use wraps every 20ms with as many counts per period as the
+// clock allows (pwm_solver.h, about 0.3us each at 150MHz), so pulse widths are
+// set finer than a microsecond. All the slices are started together and stay in
+// phase. A pose is staged with servo_set_us/servo_set_angle and servo_commit()
+// hands it to the wrap interrupt, which writes every slice's compare register in
+// one go; the hardware latches them all at the same wrap, so every joint moves in
+// the same period.
+
+#define SERVO_MAX       16
+#define SERVO_PERIOD_US 20000
+#define SERVO_MIN_US    500  // 0 degrees
+#define SERVO_MAX_US    2500 // 180 degrees
+
+// claim the PWM channel on gpio, returns the servo index or -1 if the channel is
+// taken or there are already SERVO_MAX. Attach everything before servo_start()
+int servo_attach(uint gpio);
+// start every attached slice in phase and enable the wrap interrupt
+void servo_start(void);
+
+// stage a pulse width (clamped to SERVO_MIN_US..SERVO_MAX_US), applied on commit
+void servo_set_us(int servo, uint32_t us);
+// the same in 16.16 fixed point microseconds
+void servo_set_us_q16(int servo, uint32_t us_q16);
+// 0-180 degrees in whole degrees
+void servo_set_angle(int servo, uint32_t degrees);
+// stage a whole pose, us[i] for servo i
+void servo_set_pose(const uint16_t *us, uint n);
+// apply everything staged at the next wrap
+void servo_commit(void);
+
+// called from the wrap interrupt before a committed pose is applied, 50 times a
+// second. It may stage and commit a new pose for this period
+void servo_set_tick_callback(void (*cb)(void));
+
+uint servo_count(void);
+// the pulse width going out right now, to the nearest microsecond
+uint32_t servo_get_us(int servo);
+
+#endif
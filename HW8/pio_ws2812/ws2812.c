@@ -6,18 +6,22 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "pico/stdlib.h"
+#include "pico/multicore.h"
 #include "hardware/pio.h"
 #include "hardware/clocks.h"
 #include "ws2812.pio.h"
+#include "ws2812_strip.h"
+#include "ws2812_layers.h"
 
 /**
  * NOTE:
  *  Take into consideration if your WS2812 is a RGB or RGBW variant.
  *
  *  If it is RGBW, you need to set IS_RGBW to true and provide 4 bytes per 
- *  pixel (Red, Green, Blue, White) and use urgbw_u32().
+ *  pixel (Red, Green, Blue, White) and use ws2812_rgbw().
  *
  *  If it is RGB, set IS_RGBW to false and provide 3 bytes per pixel (Red,
  *  Green, Blue) and use urgb_u32().
@@ -40,125 +44,160 @@
 #error Attempting to use a pin>=32 on a platform that does not support it
 #endif
 
-typedef struct {
-    unsigned char r;
-    unsigned char g;
-    unsigned char b;
-} wsColor; 
+static ws2812_strip_t strip;
+// one frame goes out while core1 draws the next
+static uint32_t frames[2][NUM_PIXELS];
 
-static inline void put_pixel(PIO pio, uint sm, uint32_t pixel_grb) {
-    pio_sm_put_blocking(pio, sm, pixel_grb << 8u);
+static inline uint32_t urgb_u32(uint8_t r, uint8_t g, uint8_t b) {
+    return ws2812_rgb(r, g, b);
 }
 
-static inline uint32_t urgb_u32(uint8_t r, uint8_t g, uint8_t b) {
-    return
-            ((uint32_t) (g) << 8) |
-            ((uint32_t) (r) << 16) |
-            (uint32_t) (b);
+void color_set(uint32_t *frame, wsColor colors[]){
+
+    for(int i=0;i<NUM_PIXELS;i++){
+        frame[i] = urgb_u32(colors[i].r, colors[i].g, colors[i].b); // assuming you've made arrays of colors to send
+    }
+    ws2812_strip_show(&strip, frame); // latched by the strip's alarm, no sleep needed
 }
 
-static inline uint32_t urgbw_u32(uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
-    return
-            ((uint32_t) (r) << 8) |
-            ((uint32_t) (g) << 16) |
-            ((uint32_t) (w) << 24) |
-            (uint32_t) (b);
+// every layer is drawn from scratch each frame, so "random" is a hash of where
+// and when
+static inline uint32_t hash32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
 }
 
-void color_set(PIO pio, uint sm, wsColor colors[]){
-    
-    for(int i=0;i<NUM_PIXELS;i++){
-        put_pixel(pio, sm, urgb_u32(colors[i].r, colors[i].g, colors[i].b)); // assuming you've made arrays of colors to send
+// patterns draw a whole frame as the strip takes it (ws2812_color.h)
+void pattern_snakes(uint32_t *frame, uint len, uint t) {
+    for (uint i = 0; i < len; ++i) {
+        uint x = (i + (t >> 1)) % 64;
+        if (x < 10)
+            frame[i] = urgb_u32(0xff, 0, 0);
+        else if (x >= 15 && x < 25)
+            frame[i] = urgb_u32(0, 0xff, 0);
+        else if (x >= 30 && x < 40)
+            frame[i] = urgb_u32(0, 0, 0xff);
+        else
+            frame[i] = 0;
+    }
+}
+
+void pattern_random(uint32_t *frame, uint len, uint t) {
+    for (uint i = 0; i < len; ++i)
+        frame[i] = hash32((t / 8) * len + i) << 8u;
+}
+
+void pattern_sparkle(uint32_t *frame, uint len, uint t) {
+    for (uint i = 0; i < len; ++i)
+        frame[i] = hash32((t / 8) * len + i) % 16 ? 0 : 0xffffff00u;
+}
+
+void pattern_rainbow(uint32_t *frame, uint len, uint t) {
+    // one turn of the colour wheel along the strip, moving a little each step
+    ws2812_rainbow_frame(frame, len, t * 256, 0x10000 / len, 255, 64, true);
+}
+
+void pattern_greys(uint32_t *frame, uint len, uint t) {
+    uint max = 100; // let's not draw too much current!
+    t %= max;
+    for (uint i = 0; i < len; ++i) {
+        frame[i] = (t * 0x10101) << 8u;
+        if (++t >= max) t = 0;
     }
-    sleep_ms(1);
 }
 
-typedef void (*pattern)(PIO pio, uint sm, uint len, uint t);
 const struct {
-    pattern pat;
+    fx_draw_fn pat;
     const char *name;
 } pattern_table[] = {
         {pattern_snakes,  "Snakes!"},
         {pattern_random,  "Random data"},
         {pattern_sparkle, "Sparkles"},
         {pattern_greys,   "Greys"},
+        {pattern_rainbow, "Rainbow"},
 };
 
-wsColor HSBtoRGB(float hue, float sat, float brightness) {
-    float red = 0.0;
-    float green = 0.0;
-    float blue = 0.0;
-
-    if (sat == 0.0) {
-        red = brightness;
-        green = brightness;
-        blue = brightness;
-    } else {
-        if (hue == 360.0) {
-            hue = 0;
-        }
+// overlay: a white head with a fading tail running along the strip
+void overlay_comet(uint32_t *frame, uint len, uint t) {
+    uint head = t % len;
+    for (uint i = 0; i < len; ++i) {
+        uint d = (head + len - i) % len;
+        frame[i] = d < 8 ? urgb_u32(0xff >> d, 0xff >> d, 0xff >> d) : 0;
+    }
+}
 
-        int slice = hue / 60.0;
-        float hue_frac = (hue / 60.0) - slice;
-
-        float aa = brightness * (1.0 - sat);
-        float bb = brightness * (1.0 - sat * hue_frac);
-        float cc = brightness * (1.0 - sat * (1.0 - hue_frac));
-
-        switch (slice) {
-            case 0:
-                red = brightness;
-                green = cc;
-                blue = aa;
-                break;
-            case 1:
-                red = bb;
-                green = brightness;
-                blue = aa;
-                break;
-            case 2:
-                red = aa;
-                green = brightness;
-                blue = cc;
-                break;
-            case 3:
-                red = aa;
-                green = bb;
-                blue = brightness;
-                break;
-            case 4:
-                red = cc;
-                green = aa;
-                blue = brightness;
-                break;
-            case 5:
-                red = brightness;
-                green = aa;
-                blue = bb;
-                break;
-            default:
-                red = 0.0;
-                green = 0.0;
-                blue = 0.0;
-                break;
-        }
+// mask: a triangle wave of light along the strip
+void mask_wave(uint8_t *alpha, uint len, uint t) {
+    for (uint i = 0; i < len; ++i) {
+        uint x = (i * 64 + t * 4) & 0x1ff;
+        alpha[i] = x < 0x100 ? x : 0x1ff - x;
     }
+}
+
+// Core1 draws the layers into one frame buffer while core0 sends the other. The
+// SIO FIFO carries buffer numbers: core1 sends each one it has drawn, core0
+// sends one back once show() has waited for it to latch
+#define FRAME_MS     10   // the animation steps every 10ms
+#define SCENE_FRAMES 1000
 
-    unsigned char ired = red * 255.0;
-    unsigned char igreen = green * 255.0;
-    unsigned char iblue = blue * 255.0;
+static uint32_t canvas[NUM_PIXELS];
+static uint32_t layerPixels[NUM_PIXELS];
+static uint8_t layerAlpha[NUM_PIXELS];
 
-    wsColor c;
-    c.r = ired;
-    c.g = igreen;
-    c.b = iblue;
-    return c;
+// render_* written by core1, the rest by core0
+static struct {
+    uint32_t frames;
+    uint32_t render_us;     // core1, last frame
+    uint32_t max_render_us;
+    uint32_t frame_us;      // core0, between the last two frames
+    uint32_t starved;       // frames core0 had to wait for core1
+} stats;
+
+// a new random pattern, maybe with the comet and the wave, every SCENE_FRAMES
+static void core1_entry(void) {
+    fx_layer_t layers[3];
+    uint n = 0;
+    int t = 0;
+    int dir = 1;
+    for (uint frame = 0;; frame++) {
+        uint b = multicore_fifo_pop_blocking() & 1u;
+        if (frame % SCENE_FRAMES == 0) {
+            int pat = rand() % count_of(pattern_table);
+            dir = (rand() >> 30) & 1 ? 1 : -1;
+            n = 0;
+            layers[n++] = (fx_layer_t) {pattern_table[pat].pat, NULL, FX_BLEND_NORMAL, 0xff};
+            bool comet = rand() & 1;
+            if (comet) {
+                layers[n++] = (fx_layer_t) {overlay_comet, NULL, FX_BLEND_ADD, 0xc0};
+            }
+            bool wave = rand() & 1;
+            if (wave) {
+                layers[n++] = (fx_layer_t) {NULL, mask_wave, FX_BLEND_MASK, 0xff};
+            }
+            printf("%s%s%s %s\n", pattern_table[pat].name, comet ? " + comet" : "", wave ? " + wave" : "",
+                   dir == 1 ? "(forward)" : "(backward)");
+        }
+
+        uint64_t t0 = time_us_64();
+        fx_render_layers(canvas, layerPixels, layerAlpha, NUM_PIXELS, layers, n, t);
+        memcpy(frames[b], canvas, sizeof(canvas));
+        stats.render_us = (uint32_t) (time_us_64() - t0);
+        if (stats.render_us > stats.max_render_us) stats.max_render_us = stats.render_us;
+        t += dir;
+
+        multicore_fifo_push_blocking(b);
+    }
 }
 
 int main() {
     //set_sys_clock_48();
     stdio_init_all();
     printf("WS2812 Smoke Test, using pin %d\n", WS2812_PIN);
+    ws2812_color_benchmark(300);
 
     // todo get free sm
     PIO pio;
@@ -172,17 +211,43 @@ int main() {
     hard_assert(success);
 
     ws2812_program_init(pio, sm, offset, WS2812_PIN, 800000, IS_RGBW);
+    ws2812_strip_init(&strip, pio, sm, NUM_PIXELS);
+    printf("%d pixels, %lu us a frame\n", NUM_PIXELS, (unsigned long)ws2812_frame_us(NUM_PIXELS, IS_RGBW));
 
-    int t = 0;
+    // core1 draws, this core only sends. It starts with both buffers
+    multicore_launch_core1(core1_entry);
+    multicore_fifo_push_blocking(0);
+    multicore_fifo_push_blocking(1);
+
+    int shown = -1;
+    uint64_t lastShow = 0;
+    absolute_time_t next = make_timeout_time_ms(FRAME_MS);
     while (1) {
-        int pat = rand() % count_of(pattern_table);
-        int dir = (rand() >> 30) & 1 ? 1 : -1;
-        puts(pattern_table[pat].name);
-        puts(dir == 1 ? "(forward)" : "(backward)");
-        for (int i = 0; i < 1000; ++i) {
-            pattern_table[pat].pat(pio, sm, NUM_PIXELS, t);
-            sleep_ms(10);
-            t += dir;
+        while (!time_reached(next)) {
+            tight_loop_contents();
+        }
+        next = delayed_by_ms(next, FRAME_MS);
+
+        if (!multicore_fifo_rvalid()) {
+            stats.starved++;
+        }
+        uint b = multicore_fifo_pop_blocking() & 1u;
+        // waits for the frame before to latch, so that one can go back to core1
+        ws2812_strip_show(&strip, frames[b]);
+        if (shown >= 0) {
+            multicore_fifo_push_blocking(shown);
+        }
+        shown = b;
+
+        uint64_t now = time_us_64();
+        if (lastShow) {
+            stats.frame_us = (uint32_t) (now - lastShow);
+        }
+        lastShow = now;
+        if (++stats.frames % SCENE_FRAMES == 0) {
+            printf("%lu frames, %lu us a frame: %lu us drawing (longest %lu), %lu waits for core1\n",
+                   (unsigned long) stats.frames, (unsigned long) stats.frame_us, (unsigned long) stats.render_us,
+                   (unsigned long) stats.max_render_us, (unsigned long) stats.starved);
         }
     }
 
@@ -0,0 +1,225 @@
+#if !PICO_ON_DEVICE
+#define _POSIX_C_SOURCE 199309L
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "ws2812_color.h"
+
+#if PICO_ON_DEVICE
+#include "pico/stdlib.h"
+#else
+#include <time.h>
+#endif
+
+#define BENCH_FRAMES 20
+#define BENCH_MAX_LEN 1024
+
+// round(255 * (i / 255)^2.2)
+const uint8_t ws2812_gamma8[256] = {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+      3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+      6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+     12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+     20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+     30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+     42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+     56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+     73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+     91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+    113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+    137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+    163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+    192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+    223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255,
+};
+
+// x / 255 without a divide, exact for x < 65535
+static inline uint32_t div255(uint32_t x) {
+    return (x + 1 + (x >> 8)) >> 8;
+}
+
+wsColor ws2812_hsv(uint16_t h, uint8_t s, uint8_t v) {
+    // which sixth of the circle, and how far through it out of 256
+    uint32_t h6 = (uint32_t) h * 6;
+    uint32_t sector = h6 >> 16;
+    uint32_t f = (h6 >> 8) & 0xff;
+
+    // the same three levels as HSBtoRGB, rounded
+    uint8_t p = div255(v * (255 - s) + 127);
+    uint8_t q = div255(v * (255 - div255(s * f + 127)) + 127);
+    uint8_t t = div255(v * (255 - div255(s * (255 - f) + 127)) + 127);
+
+    wsColor c;
+    switch (sector) {
+        case 0:  c.r = v; c.g = t; c.b = p; break;
+        case 1:  c.r = q; c.g = v; c.b = p; break;
+        case 2:  c.r = p; c.g = v; c.b = t; break;
+        case 3:  c.r = p; c.g = q; c.b = v; break;
+        case 4:  c.r = t; c.g = p; c.b = v; break;
+        default: c.r = v; c.g = p; c.b = q; break;
+    }
+    return c;
+}
+
+wsColor HSBtoRGB(float hue, float sat, float brightness) {
+    float red = 0.0;
+    float green = 0.0;
+    float blue = 0.0;
+
+    if (sat == 0.0) {
+        red = brightness;
+        green = brightness;
+        blue = brightness;
+    } else {
+        if (hue == 360.0) {
+            hue = 0;
+        }
+
+        int slice = hue / 60.0;
+        float hue_frac = (hue / 60.0) - slice;
+
+        float aa = brightness * (1.0 - sat);
+        float bb = brightness * (1.0 - sat * hue_frac);
+        float cc = brightness * (1.0 - sat * (1.0 - hue_frac));
+
+        switch (slice) {
+            case 0:
+                red = brightness;
+                green = cc;
+                blue = aa;
+                break;
+            case 1:
+                red = bb;
+                green = brightness;
+                blue = aa;
+                break;
+            case 2:
+                red = aa;
+                green = brightness;
+                blue = cc;
+                break;
+            case 3:
+                red = aa;
+                green = bb;
+                blue = brightness;
+                break;
+            case 4:
+                red = cc;
+                green = aa;
+                blue = brightness;
+                break;
+            case 5:
+                red = brightness;
+                green = aa;
+                blue = bb;
+                break;
+            default:
+                red = 0.0;
+                green = 0.0;
+                blue = 0.0;
+                break;
+        }
+    }
+
+    unsigned char ired = red * 255.0;
+    unsigned char igreen = green * 255.0;
+    unsigned char iblue = blue * 255.0;
+
+    wsColor c;
+    c.r = ired;
+    c.g = igreen;
+    c.b = iblue;
+    return c;
+}
+
+static inline uint32_t pack(wsColor c, bool gamma) {
+    if (gamma) {
+        return ws2812_rgb(ws2812_gamma8[c.r], ws2812_gamma8[c.g], ws2812_gamma8[c.b]);
+    }
+    return ws2812_rgb(c.r, c.g, c.b);
+}
+
+void ws2812_hsv_frame(uint32_t *frame, const wsHSV *hsv, uint32_t len, bool gamma) {
+    for (uint32_t i = 0; i < len; i++) {
+        frame[i] = pack(ws2812_hsv(hsv[i].h, hsv[i].s, hsv[i].v), gamma);
+    }
+}
+
+void ws2812_rainbow_frame(uint32_t *frame, uint32_t len, uint16_t hue, uint16_t hue_step,
+                          uint8_t s, uint8_t v, bool gamma) {
+    for (uint32_t i = 0; i < len; i++) {
+        frame[i] = pack(ws2812_hsv(hue, s, v), gamma);
+        hue += hue_step;
+    }
+}
+
+static uint64_t now_ns(void) {
+#if PICO_ON_DEVICE
+    return time_us_64() * 1000;
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+#endif
+}
+
+void ws2812_color_benchmark(uint32_t len) {
+    static wsHSV hsv[BENCH_MAX_LEN];
+    static uint32_t frame[BENCH_MAX_LEN];
+    if (len > BENCH_MAX_LEN) {
+        len = BENCH_MAX_LEN;
+    }
+    for (uint32_t i = 0; i < len; i++) {
+        hsv[i].h = (uint16_t) rand();
+        hsv[i].s = (uint8_t) rand();
+        hsv[i].v = (uint8_t) rand();
+    }
+
+    // the float version, one pixel at a time as ws2812.c used it
+    uint64_t t0 = now_ns();
+    for (int n = 0; n < BENCH_FRAMES; n++) {
+        for (uint32_t i = 0; i < len; i++) {
+            wsColor c = HSBtoRGB(hsv[i].h * (360.0f / 65536.0f), hsv[i].s / 255.0f, hsv[i].v / 255.0f);
+            frame[i] = ws2812_rgb(c.r, c.g, c.b);
+        }
+        __asm volatile("" ::: "memory");
+    }
+    uint64_t t1 = now_ns();
+    for (int n = 0; n < BENCH_FRAMES; n++) {
+        ws2812_hsv_frame(frame, hsv, len, false);
+        __asm volatile("" ::: "memory");
+    }
+    uint64_t t2 = now_ns();
+    for (int n = 0; n < BENCH_FRAMES; n++) {
+        ws2812_hsv_frame(frame, hsv, len, true);
+        __asm volatile("" ::: "memory");
+    }
+    uint64_t t3 = now_ns();
+
+    int worst = 0;
+    for (uint32_t i = 0; i < len; i++) {
+        wsColor a = HSBtoRGB(hsv[i].h * (360.0f / 65536.0f), hsv[i].s / 255.0f, hsv[i].v / 255.0f);
+        wsColor b = ws2812_hsv(hsv[i].h, hsv[i].s, hsv[i].v);
+        int d[3] = {abs(a.r - b.r), abs(a.g - b.g), abs(a.b - b.b)};
+        for (int k = 0; k < 3; k++) {
+            if (d[k] > worst) worst = d[k];
+        }
+    }
+
+    uint64_t pixels = (uint64_t) BENCH_FRAMES * len;
+    printf("HSV to frame, %lu pixels\n", (unsigned long) len);
+    printf("  float HSBtoRGB   %6lu ns/pixel\n", (unsigned long) ((t1 - t0) / pixels));
+    printf("  integer          %6lu ns/pixel\n", (unsigned long) ((t2 - t1) / pixels));
+    printf("  integer + gamma  %6lu ns/pixel\n", (unsigned long) ((t3 - t2) / pixels));
+    printf("  worst channel difference %d/255\n", worst);
+}
+
+#if !PICO_ON_DEVICE
+int main(int argc, char **argv) {
+    uint32_t len = argc > 1 ? (uint32_t) atoi(argv[1]) : 300;
+    ws2812_color_benchmark(len);
+    return 0;
+}
+#endif
@@ -0,0 +1,53 @@
+#ifndef WS2812_COLOR_H__
+#define WS2812_COLOR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Colour maths for the strips, all integer.
+// Hue is 16 bits for a full turn (0x10000 would be 360 degrees), saturation and
+// value 0-255. The batch calls write a whole frame of words ready for
+// ws2812_strip_show(), optionally through a gamma 2.2 table so fades look even.
+//
+// HSBtoRGB is the original float version, kept to compare against. The file also
+// builds on a PC to benchmark the two:
+//   gcc -O2 -o color ws2812_color.c && ./color 300
+
+typedef struct {
+    unsigned char r;
+    unsigned char g;
+    unsigned char b;
+} wsColor;
+
+typedef struct {
+    uint16_t h;
+    uint8_t s;
+    uint8_t v;
+} wsHSV;
+
+extern const uint8_t ws2812_gamma8[256];
+
+// frame words, in the same byte order as put_pixel(urgb_u32()) / urgbw_u32() sent
+static inline uint32_t ws2812_rgb(uint8_t r, uint8_t g, uint8_t b) {
+    return ((uint32_t) (r) << 24) | ((uint32_t) (g) << 16) | ((uint32_t) (b) << 8);
+}
+
+static inline uint32_t ws2812_rgbw(uint8_t r, uint8_t g, uint8_t b, uint8_t w) {
+    return ((uint32_t) (w) << 24) | ((uint32_t) (g) << 16) | ((uint32_t) (r) << 8) | b;
+}
+
+wsColor ws2812_hsv(uint16_t h, uint8_t s, uint8_t v);
+// hue in degrees, sat and brightness 0-1
+wsColor HSBtoRGB(float hue, float sat, float brightness);
+
+// len pixels of hsv to frame words
+void ws2812_hsv_frame(uint32_t *frame, const wsHSV *hsv, uint32_t len, bool gamma);
+// hue steps by hue_step along the strip from hue
+void ws2812_rainbow_frame(uint32_t *frame, uint32_t len, uint16_t hue, uint16_t hue_step,
+                          uint8_t s, uint8_t v, bool gamma);
+
+// time HSBtoRGB against the integer path for a strip of len pixels and print
+// ns per pixel and the largest difference in any channel
+void ws2812_color_benchmark(uint32_t len);
+
+#endif
@@ -0,0 +1,72 @@
+#include "ws2812_dither.h"
+
+static uint fracBits = DITHER_DEFAULT_FRAC_BITS;
+static uint decayFrames = 0;   // frames left to halve the error
+static bool dropError = false; // frac_bits changed, the old error is in the wrong planes
+
+void dither_set_frac_bits(uint frac_bits) {
+    if (frac_bits > MAX_FRAC_BITS) {
+        frac_bits = MAX_FRAC_BITS;
+    }
+    if (frac_bits != fracBits) {
+        fracBits = frac_bits;
+        dropError = true;
+    }
+}
+
+uint dither_get_frac_bits(void) {
+    return fracBits;
+}
+
+void dither_decay(void) {
+    // after frac_bits halvings there's nothing left
+    decayFrames = fracBits;
+}
+
+uint dither_next_frame(void) {
+    if (dropError) {
+        dropError = false;
+        decayFrames = 0;
+        return MAX_FRAC_BITS;
+    }
+    if (decayFrames) {
+        decayFrames--;
+        return 1;
+    }
+    return 0;
+}
+
+// Add the fraction planes of e (shifted right by shift) to d
+static void add_error(value_bits_t *d, const value_bits_t *e, uint32_t mask, uint shift) {
+    uint32_t carry_plane = 0;
+    int top = 8 + fracBits - 1;
+    // add the frac_bits low planes
+    for (int p = top; p >= 8; p--) {
+        uint32_t e_plane = p - (int) shift >= 8 ? e->planes[p - shift] & mask : 0;
+        uint32_t s_plane = d->planes[p];
+        d->planes[p] = (e_plane ^ s_plane) ^ carry_plane;
+        carry_plane = (e_plane & s_plane) | (carry_plane & (s_plane ^ e_plane));
+    }
+    // then just ripple carry through the non fractional bits
+    for (int p = 7; p >= 0 && carry_plane; p--) {
+        uint32_t s_plane = d->planes[p];
+        d->planes[p] = s_plane ^ carry_plane;
+        carry_plane &= s_plane;
+    }
+    // a carry out of the top means the lane was already at full, keep it there
+    if (carry_plane) {
+        for (int p = 0; p <= top; p++) {
+            d->planes[p] |= carry_plane;
+        }
+    }
+}
+
+void dither_values(value_bits_t *state, const value_bits_t *old_state, uint value_length, uint32_t lane_mask,
+                   uint shift) {
+    if (!fracBits || !lane_mask || shift >= fracBits) {
+        return;
+    }
+    for (uint i = 0; i < value_length; i++) {
+        add_error(state + i, old_state + i, lane_mask, shift);
+    }
+}
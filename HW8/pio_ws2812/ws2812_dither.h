@@ -0,0 +1,37 @@
+#ifndef WS2812_DITHER_H__
+#define WS2812_DITHER_H__
+
+#include "ws2812_planes.h"
+
+// Temporal dithering for the bit planes.
+// Values carry frac_bits below the 8 bits that are sent. Each frame the fraction
+// left over from the last frame is added back in, so over 2^frac_bits frames a
+// lane averages out to the level asked for rather than its top 8 bits: fades keep
+// going smoothly below one step of 8 bit colour. More bits means finer levels but
+// a slower (visible below ~100fps) flicker pattern; 0 turns it off. Strips can opt
+// out with strip->dither.
+//
+// When the picture changes completely the carried error no longer means anything,
+// but throwing it away in one go makes a visible step. dither_decay() halves it
+// every frame instead until it's gone.
+//
+// ws2812_dither_test.c checks all of that on a PC:
+//   gcc -O2 -o dither_test ws2812_dither_test.c ws2812_dither.c && ./dither_test
+
+#define DITHER_DEFAULT_FRAC_BITS 4
+
+// 0 (off) to MAX_FRAC_BITS, takes effect on the next frame
+void dither_set_frac_bits(uint frac_bits);
+uint dither_get_frac_bits(void);
+// let the carried error die away over the next frames
+void dither_decay(void);
+
+// once a frame before dither_values: how far right to shift the carried error
+uint dither_next_frame(void);
+// state += the fraction carried in old_state >> shift, for the lanes in lane_mask.
+// Saturates rather than wrapping to black. state may be being built while old_state
+// is going out
+void dither_values(value_bits_t *state, const value_bits_t *old_state, uint value_length, uint32_t lane_mask,
+                   uint shift);
+
+#endif
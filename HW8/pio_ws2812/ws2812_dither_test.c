@@ -0,0 +1,153 @@
+#include <stdio.h>
+#include <string.h>
+#include "ws2812_dither.h"
+
+// Host test for the temporal dithering, 32 lanes at a time each holding a
+// different level, the way ws2812_set.c drives it: transform the new frame into
+// one state, dither_values() it from the other, send the top 8 planes, swap.
+//   gcc -O2 -o dither_test ws2812_dither_test.c ws2812_dither.c && ./dither_test
+
+static int failures = 0;
+
+static void check(bool ok, const char *what, uint frac_bits, uint32_t level) {
+    if (!ok && failures++ < 10) {
+        printf("FAIL %s, frac %u, level 0x%lx\n", what, frac_bits, (unsigned long) level);
+    }
+}
+
+// what transform_strips would leave: level as 8 + frac_bits planes, MSB first
+static void set_lane(value_bits_t *v, uint lane, uint32_t level, uint frac_bits) {
+    uint top = 8 + frac_bits - 1;
+    for (uint p = 0; p <= top; p++) {
+        if (level >> (top - p) & 1) v->planes[p] |= 1u << lane;
+        else v->planes[p] &= ~(1u << lane);
+    }
+}
+
+// the 8 bits that go out on the wire
+static uint32_t sent(const value_bits_t *v, uint lane) {
+    uint32_t out = 0;
+    for (uint p = 0; p < 8; p++) {
+        out = out << 1 | (v->planes[p] >> lane & 1);
+    }
+    return out;
+}
+
+static uint32_t carried(const value_bits_t *v, uint lane, uint frac_bits) {
+    uint32_t e = 0;
+    for (uint p = 8; p < 8 + frac_bits; p++) {
+        e = e << 1 | (v->planes[p] >> lane & 1);
+    }
+    return e;
+}
+
+// a frame of levels[] with the error carried from the last, returns the state that went out
+static value_bits_t states[2];
+static uint current;
+
+static value_bits_t *frame(const uint32_t *levels, uint frac_bits, uint32_t lane_mask) {
+    current ^= 1;
+    memset(&states[current], 0, sizeof(states[current]));
+    for (uint l = 0; l < WS2812_LANES; l++) {
+        set_lane(&states[current], l, levels[l], frac_bits);
+    }
+    dither_values(&states[current], &states[current ^ 1], 1, lane_mask, dither_next_frame());
+    return &states[current];
+}
+
+static void start(uint frac_bits) {
+    dither_set_frac_bits(frac_bits);
+    dither_next_frame(); // drops whatever the last frac_bits left
+    memset(states, 0, sizeof(states));
+}
+
+// every level, 2^frac_bits frames each: the 8 bits sent have to add up to the
+// level exactly (mean = level / 2^frac_bits) up to the top step, and above that
+// sit at 255 every frame rather than wrapping. Odd lanes are left out of the
+// mask and must send the level's top 8 bits unchanged
+static void test_means(uint frac_bits) {
+    uint32_t frames = 1u << frac_bits;
+    uint32_t levels = 1u << (8 + frac_bits);
+    uint32_t full = 255u << frac_bits;
+    for (uint32_t base = 0; base < levels; base += WS2812_LANES) {
+        uint32_t level[WS2812_LANES];
+        uint32_t sum[WS2812_LANES] = {0};
+        bool saturated[WS2812_LANES];
+        for (uint l = 0; l < WS2812_LANES; l++) {
+            level[l] = (base + l) % levels;
+            saturated[l] = true;
+        }
+        start(frac_bits);
+        for (uint32_t f = 0; f < frames; f++) {
+            value_bits_t *v = frame(level, frac_bits, 0x55555555);
+            for (uint l = 0; l < WS2812_LANES; l++) {
+                sum[l] += sent(v, l);
+                saturated[l] &= sent(v, l) == 255;
+            }
+        }
+        for (uint l = 0; l < WS2812_LANES; l++) {
+            if (l & 1) {
+                check(sum[l] == (level[l] >> frac_bits) * frames, "undithered lane changed", frac_bits, level[l]);
+            } else if (level[l] <= full) {
+                check(sum[l] == level[l], "mean", frac_bits, level[l]);
+            } else {
+                check(saturated[l], "saturation", frac_bits, level[l]);
+            }
+        }
+    }
+}
+
+// the picture goes black with the most error carried: decay has to halve it
+// each frame (no step up from black) and clear it after frac_bits frames
+static void test_decay(uint frac_bits) {
+    uint32_t level[WS2812_LANES];
+    start(frac_bits);
+    for (uint l = 0; l < WS2812_LANES; l++) {
+        level[l] = (1u << frac_bits) - 1; // all fraction, nothing sent, error builds
+    }
+    for (uint f = 0; f < 3; f++) {
+        frame(level, frac_bits, 0xffffffff);
+    }
+    uint32_t e = carried(&states[current], 0, frac_bits);
+
+    memset(level, 0, sizeof(level));
+    dither_decay();
+    for (uint f = 0; f < frac_bits; f++) {
+        value_bits_t *v = frame(level, frac_bits, 0xffffffff);
+        e >>= 1;
+        check(sent(v, 0) == 0, "decay sent something", frac_bits, e);
+        check(carried(v, 0, frac_bits) == e, "decay didn't halve", frac_bits, e);
+    }
+    check(carried(&states[current], 0, frac_bits) == 0, "decay left error", frac_bits, 0);
+    check(dither_next_frame() == 0, "decay didn't stop", frac_bits, 0);
+}
+
+// changing frac_bits drops the error instead of adding it into the wrong planes
+static void test_change(uint frac_bits) {
+    uint32_t level[WS2812_LANES];
+    start(frac_bits);
+    for (uint l = 0; l < WS2812_LANES; l++) {
+        level[l] = (0x80u << frac_bits) | ((1u << frac_bits) - 1);
+    }
+    for (uint f = 0; f < 3; f++) {
+        frame(level, frac_bits, 0xffffffff);
+    }
+    uint other = frac_bits == MAX_FRAC_BITS ? 0 : frac_bits + 1;
+    dither_set_frac_bits(other);
+    for (uint l = 0; l < WS2812_LANES; l++) {
+        level[l] = 0x80u << other;
+    }
+    value_bits_t *v = frame(level, other, 0xffffffff);
+    check(sent(v, 0) == 0x80 && carried(v, 0, other) == 0, "error kept over a frac_bits change", other, 0x80);
+}
+
+int main(void) {
+    for (uint fb = 0; fb <= MAX_FRAC_BITS; fb++) {
+        test_means(fb);
+        if (fb) test_decay(fb);
+        test_change(fb);
+        printf("frac %u: %u levels over %u frames\n", fb, 1u << (8 + fb), 1u << fb);
+    }
+    printf(failures ? "%d failures\n" : "dither ok\n", failures);
+    return failures != 0;
+}
@@ -0,0 +1,162 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ws2812_fx.h"
+#include "pico/multicore.h"
+
+// FIFO words: the data buffer, plus a flag from core1 when the scene changed
+#define FX_MSG_BUFFER    1u
+#define FX_MSG_NEW_SCENE 2u
+
+typedef struct {
+    strip_t *strip;
+    uint8_t *data[2];
+} fx_strip_t;
+
+static fx_strip_t *fxStrips;
+static uint8_t **bufferData[2]; // data[b] of every strip, for the source
+static uint numStrips = 0;
+
+// core1 only
+static fx_scene_fn sceneFn;
+static fx_source_fn sourceFn;
+static bool fromSource = false;
+static fx_layer_t layers[FX_MAX_LAYERS];
+static uint numLayers = 0;
+static bool newScene = false;
+static uint32_t *canvas;
+static uint32_t *layerPixels;
+static uint8_t *layerAlpha;
+
+// render_* written by core1, the rest by core0
+static fx_stats_t stats;
+static uint64_t lastShow = 0;
+
+// canvas to strip bytes, as ws2812_set_pixel does
+static void pack(uint8_t *data, const uint32_t *pixels, uint len, bool rgbw) {
+    for (uint i = 0; i < len; i++) {
+        data[0] = pixels[i] & 0xffu;
+        data[1] = (pixels[i] >> 8u) & 0xffu;
+        data[2] = (pixels[i] >> 16u) & 0xffu;
+        if (rgbw) {
+            data[3] = 0;
+            data += 4;
+        } else {
+            data += 3;
+        }
+    }
+}
+
+static void render_strip(const strip_t *strip, uint8_t *data, uint t) {
+    fx_render_layers(canvas, layerPixels, layerAlpha, strip->num_pixels, layers, numLayers, t);
+    pack(data, canvas, strip->num_pixels, strip->rgbw);
+}
+
+static void core1_entry(void) {
+    uint frame = 0;
+    while (true) {
+        // a buffer core0 is done with
+        uint b = multicore_fifo_pop_blocking() & FX_MSG_BUFFER;
+        bool sourced = sourceFn && sourceFn(bufferData[b]);
+        if (sourced != fromSource) {
+            // switching between the source and the layers is a new picture too
+            fromSource = sourced;
+            newScene = true;
+        }
+        if (!sourced) {
+            uint64_t t0 = time_us_64();
+            uint t = sceneFn(frame++);
+            for (uint s = 0; s < numStrips; s++) {
+                render_strip(fxStrips[s].strip, fxStrips[s].data[b], t);
+            }
+            stats.render_us = (uint32_t) (time_us_64() - t0);
+            if (stats.render_us > stats.max_render_us) stats.max_render_us = stats.render_us;
+        }
+
+        uint32_t msg = b;
+        if (newScene) {
+            msg |= FX_MSG_NEW_SCENE;
+            newScene = false;
+        }
+        multicore_fifo_push_blocking(msg);
+    }
+}
+
+bool fx_init(strip_t *strips, uint num_strips) {
+    uint max_len = 0;
+    fxStrips = calloc(num_strips, sizeof(fx_strip_t));
+    bufferData[0] = calloc(num_strips, sizeof(uint8_t *));
+    bufferData[1] = calloc(num_strips, sizeof(uint8_t *));
+    if (!fxStrips || !bufferData[0] || !bufferData[1]) {
+        return false;
+    }
+    for (uint s = 0; s < num_strips; s++) {
+        fxStrips[s].strip = &strips[s];
+        fxStrips[s].data[0] = strips[s].data;
+        fxStrips[s].data[1] = calloc(strips[s].data_len, 1);
+        if (!fxStrips[s].data[1]) {
+            return false;
+        }
+        bufferData[0][s] = fxStrips[s].data[0];
+        bufferData[1][s] = fxStrips[s].data[1];
+        if (strips[s].num_pixels > max_len) max_len = strips[s].num_pixels;
+    }
+    numStrips = num_strips;
+    canvas = malloc(max_len * sizeof(uint32_t));
+    layerPixels = malloc(max_len * sizeof(uint32_t));
+    layerAlpha = malloc(max_len);
+    return canvas && layerPixels && layerAlpha;
+}
+
+void fx_set_source(fx_source_fn source) {
+    sourceFn = source;
+}
+
+void fx_launch(fx_scene_fn scene) {
+    sceneFn = scene;
+    multicore_launch_core1(core1_entry);
+    // core1 starts with both buffers
+    multicore_fifo_push_blocking(0);
+    multicore_fifo_push_blocking(1);
+}
+
+void fx_set_layers(const fx_layer_t *new_layers, uint num_layers) {
+    if (num_layers > FX_MAX_LAYERS) {
+        num_layers = FX_MAX_LAYERS;
+    }
+    memcpy(layers, new_layers, num_layers * sizeof(fx_layer_t));
+    numLayers = num_layers;
+}
+
+void fx_new_scene(void) {
+    newScene = true;
+}
+
+void fx_show(uint frac_brightness) {
+    if (!multicore_fifo_rvalid()) {
+        stats.starved++;
+    }
+    uint32_t msg = multicore_fifo_pop_blocking();
+    uint b = msg & FX_MSG_BUFFER;
+    for (uint s = 0; s < numStrips; s++) {
+        fxStrips[s].strip->data = fxStrips[s].data[b];
+    }
+    if (msg & FX_MSG_NEW_SCENE) {
+        dither_decay();
+    }
+    ws2812_set_show(frac_brightness);
+    // the planes are built from it, so core1 can have it back
+    multicore_fifo_push_blocking(b);
+
+    uint64_t now = time_us_64();
+    if (lastShow) {
+        stats.frame_us = (uint32_t) (now - lastShow);
+    }
+    lastShow = now;
+    stats.frames++;
+}
+
+void fx_get_stats(fx_stats_t *s) {
+    *s = stats;
+}
@@ -0,0 +1,54 @@
+#ifndef WS2812_FX_H__
+#define WS2812_FX_H__
+
+#include "pico/stdlib.h"
+#include "ws2812_set.h"
+#include "ws2812_layers.h"
+
+// Layered effects for a ws2812_set, drawn on core1 while core0 sends.
+// Every frame core1 clears a canvas per strip, draws the layers over it bottom
+// to top and packs the result into one of two data buffers per strip. The buffer
+// number goes to core0 over the SIO FIFO; fx_show() points the strips at it, runs
+// ws2812_set_show() and hands the buffer back the same way. So core1 draws frame
+// n+1 while frame n is being transformed and shifted out, and core0 never touches
+// a pixel.
+//
+// Pixels are words as ws2812_set_pixel() takes them, the layers and blend modes
+// are in ws2812_layers.h.
+
+// called on core1 before each frame: set the layers for it and return the
+// animation time to draw them at
+typedef uint (*fx_scene_fn)(uint frame);
+// called on core1 first for each frame with a data buffer per strip (in the order
+// given to fx_init): fill them all and return true to send that instead of the
+// layers
+typedef bool (*fx_source_fn)(uint8_t *const *data);
+
+#define FX_MAX_LAYERS 8
+
+typedef struct {
+    uint32_t frames;
+    uint32_t render_us;     // core1, last frame
+    uint32_t max_render_us;
+    uint32_t frame_us;      // core0, between the last two frames
+    uint32_t starved;       // frames core0 had to wait for core1
+} fx_stats_t;
+
+// after ws2812_set_start(): the second data buffer for each strip and a canvas
+// as long as the longest
+bool fx_init(strip_t *strips, uint num_strips);
+// before fx_launch(), NULL for none
+void fx_set_source(fx_source_fn source);
+// start drawing on core1
+void fx_launch(fx_scene_fn scene);
+
+// from the scene function
+void fx_set_layers(const fx_layer_t *layers, uint num_layers);
+// the picture is about to change completely, let the dithering error die away
+void fx_new_scene(void);
+
+// core0: wait for the next frame from core1 and send it at frac_brightness
+void fx_show(uint frac_brightness);
+void fx_get_stats(fx_stats_t *stats);
+
+#endif
@@ -0,0 +1,89 @@
+#include <string.h>
+
+#include "ws2812_layers.h"
+
+// a * b / 255, rounded
+static inline uint32_t mul8(uint32_t a, uint32_t b) {
+    uint32_t t = a * b + 128;
+    return (t + (t >> 8)) >> 8;
+}
+
+// d + (s - d) * w / 256 for every byte, w 0-256, two bytes to a multiply
+static inline uint32_t lerp_px(uint32_t d, uint32_t s, uint32_t w) {
+    uint32_t rb = ((s & 0x00ff00ffu) * w + (d & 0x00ff00ffu) * (256 - w)) >> 8;
+    uint32_t ag = ((s >> 8) & 0x00ff00ffu) * w + ((d >> 8) & 0x00ff00ffu) * (256 - w);
+    return (rb & 0x00ff00ffu) | (ag & 0xff00ff00u);
+}
+
+static inline uint32_t add_px(uint32_t d, uint32_t s) {
+    uint32_t rb = (d & 0x00ff00ffu) + (s & 0x00ff00ffu);
+    uint32_t ag = ((d >> 8) & 0x00ff00ffu) + ((s >> 8) & 0x00ff00ffu);
+    // a carry out of a byte fills it
+    rb |= (rb & 0x01000100u) - ((rb & 0x01000100u) >> 8);
+    ag |= (ag & 0x01000100u) - ((ag & 0x01000100u) >> 8);
+    return (rb & 0x00ff00ffu) | ((ag & 0x00ff00ffu) << 8);
+}
+
+static inline uint32_t blend_bytes(uint32_t d, uint32_t s, fx_blend_t mode) {
+    uint32_t out = 0;
+    for (uint shift = 0; shift < 32; shift += 8) {
+        uint32_t a = (d >> shift) & 0xffu;
+        uint32_t b = (s >> shift) & 0xffu;
+        uint32_t c;
+        switch (mode) {
+            case FX_BLEND_MULTIPLY:
+                c = mul8(a, b);
+                break;
+            case FX_BLEND_SCREEN:
+                c = 255 - mul8(255 - a, 255 - b);
+                break;
+            default:
+                c = a > b ? a : b;
+                break;
+        }
+        out |= c << shift;
+    }
+    return out;
+}
+
+static void blend_layer(uint32_t *dst, const uint32_t *src, const uint8_t *alpha, uint len, fx_blend_t mode,
+                        uint8_t opacity) {
+    for (uint i = 0; i < len; i++) {
+        uint32_t w = alpha ? mul8(alpha[i], opacity) : opacity;
+        w += w >> 7; // 0-255 to 0-256
+        uint32_t d = dst[i];
+        if (mode == FX_BLEND_MASK) {
+            dst[i] = lerp_px(0, d, w);
+            continue;
+        }
+        if (!w) continue;
+        uint32_t s;
+        switch (mode) {
+            case FX_BLEND_NORMAL:
+                s = src[i];
+                break;
+            case FX_BLEND_ADD:
+                s = add_px(d, src[i]);
+                break;
+            default:
+                s = blend_bytes(d, src[i], mode);
+                break;
+        }
+        dst[i] = w == 256 ? s : lerp_px(d, s, w);
+    }
+}
+
+void fx_render_layers(uint32_t *canvas, uint32_t *scratch, uint8_t *alpha, uint len, const fx_layer_t *layers,
+                      uint num_layers, uint t) {
+    memset(canvas, 0, len * sizeof(uint32_t));
+    for (uint l = 0; l < num_layers; l++) {
+        const fx_layer_t *layer = &layers[l];
+        if (layer->blend != FX_BLEND_MASK) {
+            layer->draw(scratch, len, t);
+        }
+        if (layer->alpha) {
+            layer->alpha(alpha, len, t);
+        }
+        blend_layer(canvas, scratch, layer->alpha ? alpha : NULL, len, layer->blend, layer->opacity);
+    }
+}
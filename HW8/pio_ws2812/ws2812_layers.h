@@ -0,0 +1,37 @@
+#ifndef WS2812_LAYERS_H__
+#define WS2812_LAYERS_H__
+
+#include "pico/stdlib.h"
+
+// Layer compositing for the LED effects, shared by ws2812_fx (parallel strips)
+// and the single strip demo. Layers are drawn bottom to top over a cleared
+// canvas of pixel words. The blend modes work on each byte alike, so it doesn't
+// matter which byte is which colour, with integer maths only: alpha and opacity
+// are 0-255.
+
+typedef enum {
+    FX_BLEND_NORMAL,   // src over dst
+    FX_BLEND_ADD,      // saturating
+    FX_BLEND_MULTIPLY,
+    FX_BLEND_SCREEN,
+    FX_BLEND_LIGHTEN,  // max of each byte
+    FX_BLEND_MASK,     // dst *= alpha, draw is not used
+} fx_blend_t;
+
+// a layer for one strip of len pixels at animation time t
+typedef void (*fx_draw_fn)(uint32_t *pixels, uint len, uint t);
+typedef void (*fx_alpha_fn)(uint8_t *alpha, uint len, uint t);
+
+typedef struct {
+    fx_draw_fn draw;
+    fx_alpha_fn alpha; // per pixel coverage, NULL for all of it
+    fx_blend_t blend;
+    uint8_t opacity;
+} fx_layer_t;
+
+// draw the layers into canvas, with scratch and alpha (len each) to draw each
+// layer into first
+void fx_render_layers(uint32_t *canvas, uint32_t *scratch, uint8_t *alpha, uint len, const fx_layer_t *layers,
+                      uint num_layers, uint t);
+
+#endif
@@ -9,33 +9,33 @@
 #include <string.h>
 
 #include "pico/stdlib.h"
-#include "pico/sem.h"
-#include "hardware/pio.h"
-#include "hardware/dma.h"
-#include "hardware/irq.h"
-#include "ws2812.pio.h"
+#include "ws2812_set.h"
+#include "ws2812_fx.h"
+#include "ws2812_stream.h"
 
-#define FRAC_BITS 4
 #define NUM_PIXELS 64
 #define WS2812_PIN_BASE 2
+// what the 5V supply for the strips can give, in mA
+#define POWER_BUDGET_MA 2000
 
 // Check the pin is compatible with the platform
 #if WS2812_PIN_BASE >= NUM_BANK0_GPIOS
 #error Attempting to use a pin>=32 on a platform that does not support it
 #endif
 
-// horrible temporary hack to avoid changing pattern code
-static uint8_t *current_strip_out;
-static bool current_strip_4color;
+// every strip on the installation: any pins, lengths and types, consecutive
+// pins share a state machine (up to 32 of them)
+static const struct {
+    uint pin;
+    uint num_pixels;
+    bool rgbw;
+    uint frac_brightness; // 256 = *1.0
+} strip_config[] = {
+        {WS2812_PIN_BASE,     NUM_PIXELS, false, 0x40},
+        {WS2812_PIN_BASE + 1, NUM_PIXELS, true,  0x100},
+};
 
-static inline void put_pixel(uint32_t pixel_grb) {
-    *current_strip_out++ = pixel_grb & 0xffu;
-    *current_strip_out++ = (pixel_grb >> 8u) & 0xffu;
-    *current_strip_out++ = (pixel_grb >> 16u) & 0xffu;
-    if (current_strip_4color) {
-        *current_strip_out++ = 0; // todo adjust?
-    }
-}
+static strip_t strips[count_of(strip_config)];
 
 static inline uint32_t urgb_u32(uint8_t r, uint8_t g, uint8_t b) {
     return
@@ -44,53 +44,60 @@ static inline uint32_t urgb_u32(uint8_t r, uint8_t g, uint8_t b) {
             (uint32_t) (b);
 }
 
-void pattern_snakes(uint len, uint t) {
+// every layer is drawn from scratch each frame, so "random" is a hash of where
+// and when
+static inline uint32_t hash32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x7feb352du;
+    x ^= x >> 15;
+    x *= 0x846ca68bu;
+    x ^= x >> 16;
+    return x;
+}
+
+void pattern_snakes(uint32_t *pixels, uint len, uint t) {
     for (uint i = 0; i < len; ++i) {
         uint x = (i + (t >> 1)) % 64;
         if (x < 10)
-            put_pixel(urgb_u32(0xff, 0, 0));
+            pixels[i] = urgb_u32(0xff, 0, 0);
         else if (x >= 15 && x < 25)
-            put_pixel(urgb_u32(0, 0xff, 0));
+            pixels[i] = urgb_u32(0, 0xff, 0);
         else if (x >= 30 && x < 40)
-            put_pixel(urgb_u32(0, 0, 0xff));
+            pixels[i] = urgb_u32(0, 0, 0xff);
         else
-            put_pixel(0);
+            pixels[i] = 0;
     }
 }
 
-void pattern_random(uint len, uint t) {
-    if (t % 8)
-        return;
+void pattern_random(uint32_t *pixels, uint len, uint t) {
     for (uint i = 0; i < len; ++i)
-        put_pixel(rand());
+        pixels[i] = hash32((t / 8) * len + i);
 }
 
-void pattern_sparkle(uint len, uint t) {
-    if (t % 8)
-        return;
+void pattern_sparkle(uint32_t *pixels, uint len, uint t) {
     for (uint i = 0; i < len; ++i)
-        put_pixel(rand() % 16 ? 0 : 0xffffffff);
+        pixels[i] = hash32((t / 8) * len + i) % 16 ? 0 : 0xffffffff;
 }
 
-void pattern_greys(uint len, uint t) {
-    uint max = 100; // let's not draw too much current!
-    t %= max;
+void pattern_greys(uint32_t *pixels, uint len, uint t) {
+    // the power limiter keeps the current down
+    t &= 0xff;
     for (uint i = 0; i < len; ++i) {
-        put_pixel(t * 0x10101);
-        if (++t >= max) t = 0;
+        pixels[i] = t * 0x10101;
+        t = (t + 1) & 0xff;
     }
 }
 
-void pattern_solid(uint len, uint t) {
+void pattern_solid(uint32_t *pixels, uint len, uint t) {
     t = 1;
     for (uint i = 0; i < len; ++i) {
-        put_pixel(t * 0x10101);
+        pixels[i] = t * 0x10101;
     }
 }
 
 int level = 8;
 
-void pattern_fade(uint len, uint t) {
+void pattern_fade(uint32_t *pixels, uint len, uint t) {
     uint shift = 4;
 
     uint max = 16; // let's not draw too much current!
@@ -107,13 +114,12 @@ void pattern_fade(uint len, uint t) {
     slow_t *= 0x010101;
 
     for (uint i = 0; i < len; ++i) {
-        put_pixel(slow_t);
+        pixels[i] = slow_t;
     }
 }
 
-typedef void (*pattern)(uint len, uint t);
 const struct {
-    pattern pat;
+    fx_draw_fn pat;
     const char *name;
 } pattern_table[] = {
         {pattern_snakes,  "Snakes!"},
@@ -124,211 +130,106 @@ const struct {
 //        {pattern_fade, "Fade"},
 };
 
-#define VALUE_PLANE_COUNT (8 + FRAC_BITS)
-// we store value (8 bits + fractional bits of a single color (R/G/B/W) value) for multiple
-// strips of pixels, in bit planes. bit plane N has the Nth bit of each strip of pixels.
-typedef struct {
-    // stored MSB first
-    uint32_t planes[VALUE_PLANE_COUNT];
-} value_bits_t;
-
-// Add FRAC_BITS planes of e to s and store in d
-void add_error(value_bits_t *d, const value_bits_t *s, const value_bits_t *e) {
-    uint32_t carry_plane = 0;
-    // add the FRAC_BITS low planes
-    for (int p = VALUE_PLANE_COUNT - 1; p >= 8; p--) {
-        uint32_t e_plane = e->planes[p];
-        uint32_t s_plane = s->planes[p];
-        d->planes[p] = (e_plane ^ s_plane) ^ carry_plane;
-        carry_plane = (e_plane & s_plane) | (carry_plane & (s_plane ^ e_plane));
-    }
-    // then just ripple carry through the non fractional bits
-    for (int p = 7; p >= 0; p--) {
-        uint32_t s_plane = s->planes[p];
-        d->planes[p] = s_plane ^ carry_plane;
-        carry_plane &= s_plane;
-    }
-}
-
-typedef struct {
-    uint8_t *data;
-    uint data_len;
-    uint frac_brightness; // 256 = *1.0;
-} strip_t;
-
-// takes 8 bit color values, multiply by brightness and store in bit planes
-void transform_strips(strip_t **strips, uint num_strips, value_bits_t *values, uint value_length,
-                       uint frac_brightness) {
-    for (uint v = 0; v < value_length; v++) {
-        memset(&values[v], 0, sizeof(values[v]));
-        for (uint i = 0; i < num_strips; i++) {
-            if (v < strips[i]->data_len) {
-                // todo clamp?
-                uint32_t value = (strips[i]->data[v] * strips[i]->frac_brightness) >> 8u;
-                value = (value * frac_brightness) >> 8u;
-                for (int j = 0; j < VALUE_PLANE_COUNT && value; j++, value >>= 1u) {
-                    if (value & 1u) values[v].planes[VALUE_PLANE_COUNT - 1 - j] |= 1u << i;
-                }
-            }
-        }
-    }
-}
-
-void dither_values(const value_bits_t *colors, value_bits_t *state, const value_bits_t *old_state, uint value_length) {
-    for (uint i = 0; i < value_length; i++) {
-        add_error(state + i, colors + i, old_state + i);
+// overlay: a white head with a fading tail running along the strip
+void overlay_comet(uint32_t *pixels, uint len, uint t) {
+    uint head = t % len;
+    for (uint i = 0; i < len; ++i) {
+        uint d = (head + len - i) % len;
+        pixels[i] = d < 8 ? (0xff >> d) * 0x10101 : 0;
     }
 }
 
-// requested colors * 4 to allow for RGBW
-static value_bits_t colors[NUM_PIXELS * 4];
-// double buffer the state of the pixel strip, since we update next version in parallel with DMAing out old version
-static value_bits_t states[2][NUM_PIXELS * 4];
-
-// example - strip 0 is RGB only
-static uint8_t strip0_data[NUM_PIXELS * 3];
-// example - strip 1 is RGBW
-static uint8_t strip1_data[NUM_PIXELS * 4];
-
-strip_t strip0 = {
-        .data = strip0_data,
-        .data_len = sizeof(strip0_data),
-        .frac_brightness = 0x40,
-};
-
-strip_t strip1 = {
-        .data = strip1_data,
-        .data_len = sizeof(strip1_data),
-        .frac_brightness = 0x100,
-};
-
-strip_t *strips[] = {
-        &strip0,
-        &strip1,
-};
-
-// bit plane content dma channel
-#define DMA_CHANNEL 0
-// chain channel for configuring main dma channel to output from disjoint 8 word fragments of memory
-#define DMA_CB_CHANNEL 1
-
-#define DMA_CHANNEL_MASK (1u << DMA_CHANNEL)
-#define DMA_CB_CHANNEL_MASK (1u << DMA_CB_CHANNEL)
-#define DMA_CHANNELS_MASK (DMA_CHANNEL_MASK | DMA_CB_CHANNEL_MASK)
-
-// start of each value fragment (+1 for NULL terminator)
-static uintptr_t fragment_start[NUM_PIXELS * 4 + 1];
-
-// posted when it is safe to output a new set of values
-static struct semaphore reset_delay_complete_sem;
-// alarm handle for handling delay
-alarm_id_t reset_delay_alarm_id;
-
-int64_t reset_delay_complete(__unused alarm_id_t id, __unused void *user_data) {
-    reset_delay_alarm_id = 0;
-    sem_release(&reset_delay_complete_sem);
-    // no repeat
-    return 0;
-}
-
-void __isr dma_complete_handler() {
-    if (dma_hw->ints0 & DMA_CHANNEL_MASK) {
-        // clear IRQ
-        dma_hw->ints0 = DMA_CHANNEL_MASK;
-        // when the dma is complete we start the reset delay timer
-        if (reset_delay_alarm_id) cancel_alarm(reset_delay_alarm_id);
-        reset_delay_alarm_id = add_alarm_in_us(400, reset_delay_complete, NULL, true);
+// mask: a slow triangle wave of light along the strip
+void mask_wave(uint8_t *alpha, uint len, uint t) {
+    for (uint i = 0; i < len; ++i) {
+        uint x = (i * 8 + t) & 0x1ff;
+        alpha[i] = x < 0x100 ? x : 0x1ff - x;
     }
 }
 
-void dma_init(PIO pio, uint sm) {
-    dma_claim_mask(DMA_CHANNELS_MASK);
+#define SCENE_FRAMES 1000
 
-    // main DMA channel outputs 8 word fragments, and then chains back to the chain channel
-    dma_channel_config channel_config = dma_channel_get_default_config(DMA_CHANNEL);
-    channel_config_set_dreq(&channel_config, pio_get_dreq(pio, sm, true));
-    channel_config_set_chain_to(&channel_config, DMA_CB_CHANNEL);
-    channel_config_set_irq_quiet(&channel_config, true);
-    dma_channel_configure(DMA_CHANNEL,
-                          &channel_config,
-                          &pio->txf[sm],
-                          NULL, // set by chain
-                          8, // 8 words for 8 bit planes
-                          false);
-
-    // chain channel sends single word pointer to start of fragment each time
-    dma_channel_config chain_config = dma_channel_get_default_config(DMA_CB_CHANNEL);
-    dma_channel_configure(DMA_CB_CHANNEL,
-                          &chain_config,
-                          &dma_channel_hw_addr(
-                                  DMA_CHANNEL)->al3_read_addr_trig,  // ch DMA config (target "ring" buffer size 4) - this is (read_addr trigger)
-                          NULL, // set later
-                          1,
-                          false);
-
-    irq_set_exclusive_handler(DMA_IRQ_0, dma_complete_handler);
-    dma_channel_set_irq0_enabled(DMA_CHANNEL, true);
-    irq_set_enabled(DMA_IRQ_0, true);
-}
-
-void output_strips_dma(value_bits_t *bits, uint value_length) {
-    for (uint i = 0; i < value_length; i++) {
-        fragment_start[i] = (uintptr_t) bits[i].planes; // MSB first
+// core1: a new random base pattern, maybe with the comet and the wave, every
+// SCENE_FRAMES
+static uint scene(uint frame) {
+    static uint t;
+    static int dir;
+    if (frame % SCENE_FRAMES == 0) {
+        fx_layer_t layers[3];
+        uint n = 0;
+        int pat = rand() % count_of(pattern_table);
+        dir = (rand() >> 30) & 1 ? 1 : -1;
+        if (rand() & 1) dir = 0;
+        layers[n++] = (fx_layer_t) {pattern_table[pat].pat, NULL, FX_BLEND_NORMAL, 0xff};
+        bool comet = rand() & 1;
+        if (comet) {
+            layers[n++] = (fx_layer_t) {overlay_comet, NULL, FX_BLEND_ADD, 0xc0};
+        }
+        bool wave = rand() & 1;
+        if (wave) {
+            layers[n++] = (fx_layer_t) {NULL, mask_wave, FX_BLEND_MASK, 0xff};
+        }
+        fx_set_layers(layers, n);
+        if (frame) fx_new_scene();
+        printf("%s%s%s %s\n", pattern_table[pat].name, comet ? " + comet" : "", wave ? " + wave" : "",
+               dir == 1 ? "(forward)" : dir ? "(backward)" : "(still)");
     }
-    fragment_start[value_length] = 0;
-    dma_channel_hw_addr(DMA_CB_CHANNEL)->al3_read_addr_trig = (uintptr_t) fragment_start;
+    t += dir;
+    return t;
 }
 
-
 int main() {
     //set_sys_clock_48();
     stdio_init_all();
     printf("WS2812 parallel using pin %d\n", WS2812_PIN_BASE);
+    transform_benchmark(NUM_PIXELS * 4);
 
-    PIO pio;
-    uint sm;
-    uint offset;
-
-    // This will find a free pio and state machine for our program and load it for us
-    // We use pio_claim_free_sm_and_add_program_for_gpio_range (for_gpio_range variant)
-    // so we will get a PIO instance suitable for addressing gpios >= 32 if needed and supported by the hardware
-    bool success = pio_claim_free_sm_and_add_program_for_gpio_range(&ws2812_parallel_program, &pio, &sm, &offset, WS2812_PIN_BASE, count_of(strips), true);
-    hard_assert(success);
-
-    ws2812_parallel_program_init(pio, sm, offset, WS2812_PIN_BASE, count_of(strips), 800000);
+    for (uint s = 0; s < count_of(strip_config); s++) {
+        strips[s].frac_brightness = strip_config[s].frac_brightness;
+        bool added = ws2812_set_add(&strips[s], strip_config[s].pin, strip_config[s].num_pixels, strip_config[s].rgbw);
+        hard_assert(added);
+    }
+    int groups = ws2812_set_start();
+    hard_assert(groups > 0);
+    printf("%d strips on %d state machines\n", (int) count_of(strips), groups);
+    ws2812_set_power_budget(POWER_BUDGET_MA);
+
+    // core1 draws, or takes frames from the PC, this core only sends
+    bool ready = fx_init(strips, count_of(strips));
+    hard_assert(ready);
+    uint32_t frame_us = ws2812_set_frame_us();
+    uint stream_len = 0;
+    for (uint s = 0; s < count_of(strips); s++) {
+        stream_len += strips[s].data_len;
+    }
+    printf("%lu us a frame, streamed frames carry %u bytes\n", (unsigned long) frame_us, stream_len);
+    ready = ws2812_stream_init(strips, count_of(strips), frame_us);
+    hard_assert(ready);
+    fx_set_source(ws2812_stream_fill);
+    fx_launch(scene);
 
-    sem_init(&reset_delay_complete_sem, 1, 1); // initially posted so we don't block first time
-    dma_init(pio, sm);
-    int t = 0;
+    uint brightness = 0;
     while (1) {
-        int pat = rand() % count_of(pattern_table);
-        int dir = (rand() >> 30) & 1 ? 1 : -1;
-        if (rand() & 1) dir = 0;
-        puts(pattern_table[pat].name);
-        puts(dir == 1 ? "(forward)" : dir ? "(backward)" : "(still)");
-        int brightness = 0;
-        uint current = 0;
-        for (int i = 0; i < 1000; ++i) {
-            current_strip_out = strip0.data;
-            current_strip_4color = false;
-            pattern_table[pat].pat(NUM_PIXELS, t);
-            current_strip_out = strip1.data;
-            current_strip_4color = true;
-            pattern_table[pat].pat(NUM_PIXELS, t);
-
-            transform_strips(strips, count_of(strips), colors, NUM_PIXELS * 4, brightness);
-            dither_values(colors, states[current], states[current ^ 1], NUM_PIXELS * 4);
-            sem_acquire_blocking(&reset_delay_complete_sem);
-            output_strips_dma(states[current], NUM_PIXELS * 4);
-
-            current ^= 1;
-            t += dir;
-            brightness++;
-            if (brightness == (0x20 << FRAC_BITS)) brightness = 0;
+        fx_show(brightness);
+        brightness++;
+        if (brightness == BRIGHTNESS_ONE / 8) brightness = 0;
+
+        fx_stats_t fx;
+        fx_get_stats(&fx);
+        if (fx.frames % SCENE_FRAMES == 0) {
+            ws2812_set_stats_t stats;
+            ws2812_set_get_stats(&stats);
+            printf("%lu frames, %lu us a frame: %lu us drawing (longest %lu), %lu us output, "
+                   "longest wait %lu us, %lu waits for core1\n",
+                   (unsigned long) fx.frames, (unsigned long) fx.frame_us, (unsigned long) fx.render_us,
+                   (unsigned long) fx.max_render_us, (unsigned long) stats.output_us,
+                   (unsigned long) stats.max_wait_us, (unsigned long) fx.starved);
+            ws2812_stream_stats_t stream;
+            ws2812_stream_get_stats(&stream);
+            printf("stream: %lu received, %lu dropped, %lu late\n", (unsigned long) stream.received,
+                   (unsigned long) stream.dropped, (unsigned long) stream.late);
+            printf("power: %lu mA, brightness limited to %lu/256\n", (unsigned long) stats.power_ma,
+                   (unsigned long) stats.power_gain);
         }
-        memset(&states, 0, sizeof(states)); // clear out errors
     }
-
-    // This will free resources and unload our program
-    pio_remove_program_and_unclaim_sm(&ws2812_parallel_program, pio, sm, offset);
 }
@@ -0,0 +1,202 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ws2812_planes.h"
+#include "hardware/clocks.h"
+
+// 8x8 bit matrix transpose, bit 8*r+c moves to bit 8*c+r (Hacker's Delight 7-3)
+static inline uint64_t transpose8(uint64_t x) {
+    uint64_t t;
+    t = (x ^ (x >> 7)) & 0x00AA00AA00AA00AAull;
+    x ^= t ^ (t << 7);
+    t = (x ^ (x >> 14)) & 0x0000CCCC0000CCCCull;
+    x ^= t ^ (t << 14);
+    t = (x ^ (x >> 28)) & 0x00000000F0F0F0F0ull;
+    x ^= t ^ (t << 28);
+    return x;
+}
+
+// 32x32 in place, bit 31-c of a[r] swaps with bit 31-r of a[c] (Hacker's Delight 7-3)
+static void transpose32(uint32_t a[32]) {
+    uint32_t m = 0x0000FFFF;
+    for (int j = 16; j != 0; j >>= 1, m ^= (m << j)) {
+        for (int k = 0; k < 32; k = (k + j + 1) & ~j) {
+            uint32_t t = (a[k] ^ (a[k + j] >> j)) & m;
+            a[k] ^= t;
+            a[k + j] ^= t << j;
+        }
+    }
+}
+
+// per strip brightness times the global one, once a frame
+static void prepare_scales(strip_t **strips, uint num_strips, uint frac_brightness, uint32_t *scale) {
+    for (uint i = 0; i < num_strips; i++) {
+        scale[i] = (strips[i]->frac_brightness * frac_brightness) >> 8u;
+    }
+}
+
+// 8.frac_bits fixed point, clamped
+static inline uint32_t scaled_value(const strip_t *strip, uint32_t scale, uint v, uint frac_bits) {
+    if (v >= strip->data_len) return 0;
+    uint32_t value = (strip->data[v] * scale) >> (12u - frac_bits);
+    uint32_t max = (1u << (8 + frac_bits)) - 1;
+    return value > max ? max : value;
+}
+
+// up to 8 lanes at a time, a byte of each value per 8x8 transpose
+static uint32_t transform_blocks8(strip_t **strips, uint num_strips, value_bits_t *values, uint value_length,
+                                  const uint32_t *scale, uint frac_bits) {
+    uint32_t total = 0;
+    for (uint v = 0; v < value_length; v++) {
+        uint32_t planes[16] = {0}; // bit b of every lane, LSB plane first
+        uint32_t sum = 0;
+        for (uint base = 0; base < num_strips; base += 8) {
+            uint64_t lo = 0, hi = 0;
+            for (uint i = base; i < num_strips && i < base + 8; i++) {
+                uint32_t value = scaled_value(strips[i], scale[i], v, frac_bits);
+                sum += value;
+                lo |= (uint64_t) (value & 0xffu) << (8 * (i - base));
+                hi |= (uint64_t) (value >> 8u) << (8 * (i - base));
+            }
+            // at or below full brightness the top byte is usually empty
+            if (lo) {
+                lo = transpose8(lo);
+                for (int b = 0; b < 8; b++) {
+                    planes[b] |= (uint32_t) ((lo >> (8 * b)) & 0xffu) << base;
+                }
+            }
+            if (hi) {
+                hi = transpose8(hi);
+                for (int b = 0; b < 8; b++) {
+                    planes[b + 8] |= (uint32_t) ((hi >> (8 * b)) & 0xffu) << base;
+                }
+            }
+        }
+        for (uint p = 0; p < 8 + frac_bits; p++) {
+            values[v].planes[p] = planes[8 + frac_bits - 1 - p];
+        }
+        total += sum >> frac_bits;
+    }
+    return total;
+}
+
+// every lane at once with one 32x32 transpose
+static uint32_t transform_block32(strip_t **strips, uint num_strips, value_bits_t *values, uint value_length,
+                                  const uint32_t *scale, uint frac_bits) {
+    uint32_t total = 0;
+    for (uint v = 0; v < value_length; v++) {
+        // lane i goes in row 31-i so it comes out as bit i of each plane
+        uint32_t a[32] = {0};
+        uint32_t sum = 0;
+        for (uint i = 0; i < num_strips; i++) {
+            a[31 - i] = scaled_value(strips[i], scale[i], v, frac_bits);
+            sum += a[31 - i];
+        }
+        transpose32(a);
+        for (uint p = 0; p < 8 + frac_bits; p++) {
+            values[v].planes[p] = a[32 - 8 - frac_bits + p];
+        }
+        total += sum >> frac_bits;
+    }
+    return total;
+}
+
+uint32_t transform_strips(strip_t **strips, uint num_strips, value_bits_t *values, uint value_length,
+                          uint frac_brightness, uint frac_bits) {
+    uint32_t scale[WS2812_LANES];
+    hard_assert(num_strips <= WS2812_LANES && frac_bits <= MAX_FRAC_BITS);
+    prepare_scales(strips, num_strips, frac_brightness, scale);
+    if (num_strips > TRANSPOSE32_STRIPS) {
+        return transform_block32(strips, num_strips, values, value_length, scale, frac_bits);
+    }
+    return transform_blocks8(strips, num_strips, values, value_length, scale, frac_bits);
+}
+
+// the one bit at a time version, for checking and timing against
+static uint32_t transform_strips_reference(strip_t **strips, uint num_strips, value_bits_t *values,
+                                           uint value_length, uint frac_brightness, uint frac_bits) {
+    uint32_t scale[WS2812_LANES];
+    uint32_t total = 0;
+    prepare_scales(strips, num_strips, frac_brightness, scale);
+    for (uint v = 0; v < value_length; v++) {
+        memset(&values[v], 0, sizeof(values[v]));
+        uint32_t sum = 0;
+        for (uint i = 0; i < num_strips; i++) {
+            uint32_t value = scaled_value(strips[i], scale[i], v, frac_bits);
+            sum += value;
+            for (uint j = 0; j < 8 + frac_bits && value; j++, value >>= 1u) {
+                if (value & 1u) values[v].planes[8 + frac_bits - 1 - j] |= 1u << i;
+            }
+        }
+        total += sum >> frac_bits;
+    }
+    return total;
+}
+
+#define BENCH_FRAMES 10
+
+#define BENCH_FRAC_BITS 4
+
+typedef uint32_t (*transform_kernel)(strip_t **strips, uint num_strips, value_bits_t *values, uint value_length,
+                                     const uint32_t *scale, uint frac_bits);
+
+static uint32_t reference_kernel(strip_t **strips, uint num_strips, value_bits_t *values, uint value_length,
+                                 const uint32_t *scale, uint frac_bits) {
+    (void) scale;
+    return transform_strips_reference(strips, num_strips, values, value_length, BRIGHTNESS_ONE, frac_bits);
+}
+
+static uint32_t time_kernel(transform_kernel kernel, strip_t **strips, uint num_strips, value_bits_t *values,
+                            uint value_length, const uint32_t *scale, uint32_t *total) {
+    uint64_t t0 = time_us_64();
+    for (int n = 0; n < BENCH_FRAMES; n++) {
+        *total = kernel(strips, num_strips, values, value_length, scale, BENCH_FRAC_BITS);
+    }
+    uint64_t us = time_us_64() - t0;
+    return (uint32_t) (us * (clock_get_hz(clk_sys) / 1000000) / BENCH_FRAMES);
+}
+
+// on random data
+void transform_benchmark(uint value_length) {
+    strip_t bench_strips[WS2812_LANES];
+    strip_t *bench_ptrs[WS2812_LANES];
+    uint32_t scale[WS2812_LANES];
+    uint8_t *bench_data = malloc(WS2812_LANES * value_length);
+    // kernels leave the unused planes alone, so start them all at 0 to compare
+    value_bits_t *check = calloc(value_length, sizeof(value_bits_t));
+    value_bits_t *colors = calloc(value_length, sizeof(value_bits_t));
+    if (!bench_data || !check || !colors) {
+        printf("transform_benchmark: out of memory\n");
+        free(bench_data);
+        free(check);
+        free(colors);
+        return;
+    }
+    for (uint i = 0; i < WS2812_LANES; i++) {
+        bench_strips[i].data = bench_data + i * value_length;
+        bench_strips[i].data_len = value_length;
+        bench_strips[i].frac_brightness = 0x100;
+        for (uint v = 0; v < value_length; v++) bench_strips[i].data[v] = rand();
+        bench_ptrs[i] = &bench_strips[i];
+    }
+
+    printf("transform_strips, cycles per frame of %u values\n", value_length);
+    printf("strips  bit loop    8x8    32x32\n");
+    const uint counts[] = {2, 8, 32};
+    for (uint c = 0; c < count_of(counts); c++) {
+        uint n = counts[c];
+        prepare_scales(bench_ptrs, n, BRIGHTNESS_ONE, scale);
+        uint32_t ref_total, total;
+        uint32_t ref = time_kernel(reference_kernel, bench_ptrs, n, check, value_length, scale, &ref_total);
+        uint32_t b8 = time_kernel(transform_blocks8, bench_ptrs, n, colors, value_length, scale, &total);
+        bool ok8 = !memcmp(colors, check, value_length * sizeof(value_bits_t)) && total == ref_total;
+        uint32_t b32 = time_kernel(transform_block32, bench_ptrs, n, colors, value_length, scale, &total);
+        bool ok32 = !memcmp(colors, check, value_length * sizeof(value_bits_t)) && total == ref_total;
+        printf("%6u %9lu %8lu %8lu%s\n", n, (unsigned long) ref, (unsigned long) b8, (unsigned long) b32,
+               ok8 && ok32 ? "" : "  MISMATCH");
+    }
+    free(bench_data);
+    free(check);
+    free(colors);
+}
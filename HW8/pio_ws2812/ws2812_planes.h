@@ -0,0 +1,60 @@
+#ifndef WS2812_PLANES_H__
+#define WS2812_PLANES_H__
+
+#if PICO_ON_DEVICE
+#include "pico/stdlib.h"
+#else
+// just the types, so the dithering builds on a PC (ws2812_dither_test.c)
+#include <stdint.h>
+#include <stdbool.h>
+typedef unsigned int uint;
+#endif
+
+// Colour values for up to 32 parallel strips, stored as bit planes: one word per
+// bit of a value, bit i of each word for lane (strip) i. That's what the
+// ws2812_parallel program shifts out, one word per bit time for every lane at once.
+// Values carry frac_bits (0 to MAX_FRAC_BITS, see ws2812_dither.h) below the 8
+// bits sent; dithering adds the leftover fraction of the last frame to the next
+// so dim levels average out right.
+
+#define MAX_FRAC_BITS 8
+#define VALUE_PLANE_COUNT (8 + MAX_FRAC_BITS)
+#define WS2812_LANES 32 // lanes one state machine can drive
+// above this many strips transform_strips uses the 32x32 transpose instead of 8x8 blocks
+#define TRANSPOSE32_STRIPS 16
+// global brightness for transform_strips, with 4 fractional bits: BRIGHTNESS_ONE
+// is full scale whatever frac_bits is
+#define BRIGHTNESS_ONE (0x100 << 4)
+
+#if VALUE_PLANE_COUNT > 16
+#error transform_strips handles at most 8 fractional bits
+#endif
+
+// we store value (8 bits + fractional bits of a single color (R/G/B/W) value) for multiple
+// strips of pixels, in bit planes. bit plane N has the Nth bit of each strip of pixels.
+typedef struct {
+    // stored MSB first, 8 + frac_bits of them used
+    uint32_t planes[VALUE_PLANE_COUNT];
+} value_bits_t;
+
+typedef struct {
+    uint8_t *data;
+    uint data_len;
+    uint frac_brightness; // 256 = *1.0;
+    bool dither;          // carry the fraction from frame to frame, on by default
+    // filled in by ws2812_set_add
+    uint pin;
+    uint num_pixels;
+    bool rgbw;
+} strip_t;
+
+// takes 8 bit color values, multiply by brightness and store in 8 + frac_bits bit planes.
+// Returns the sum of all the values it stored, in whole steps, for the power estimate
+uint32_t transform_strips(strip_t **strips, uint num_strips, value_bits_t *values, uint value_length,
+                          uint frac_brightness, uint frac_bits);
+
+// cycles per frame of value_length values for 2, 8 and 32 strips with each
+// transform kernel, checked against the bit at a time loop
+void transform_benchmark(uint value_length);
+
+#endif
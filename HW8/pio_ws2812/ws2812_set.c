@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ws2812_set.h"
+#include "pico/sem.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "ws2812.pio.h"
+
+typedef struct {
+    PIO pio;
+    uint sm;
+    uint offset;
+    uint pin_base;
+    uint num_lanes;
+    strip_t *strips[WS2812_LANES]; // lane i is pin_base + i
+    uint value_length;             // values in the longest strip
+    value_bits_t *states[2];       // double buffered, one goes out while the next is built
+    uintptr_t *fragments[2];       // start of each value in states[n], 0 terminated
+    uint dma_chan;                 // bit planes to the TX FIFO
+    uint chain_chan;               // points dma_chan at each value in turn
+} group_t;
+
+static strip_t *strips[WS2812_SET_MAX_STRIPS];
+static uint numStrips = 0;
+static group_t groups[WS2812_SET_MAX_GROUPS];
+static uint numGroups = 0;
+static uint current = 0;
+
+// posted when it is safe to output a new set of values
+static struct semaphore latch_sem;
+static alarm_id_t latch_alarm;
+static volatile uint32_t pendingGroups; // bit per group still sending
+static uint64_t start_us;
+static ws2812_set_stats_t stats;
+
+// power limiter, gain 1 << 16 is full brightness
+#define POWER_GAIN_ONE (1u << 16)
+static uint32_t powerBudgetUa = 0;
+static uint32_t powerGain = POWER_GAIN_ONE;
+static uint32_t idleUa = 0;
+
+static int64_t latch_done(__unused alarm_id_t id, __unused void *user_data) {
+    latch_alarm = 0;
+    sem_release(&latch_sem);
+    // no repeat
+    return 0;
+}
+
+static void dma_complete_handler() {
+    for (uint g = 0; g < numGroups; g++) {
+        if (dma_channel_get_irq0_status(groups[g].dma_chan)) {
+            dma_channel_acknowledge_irq0(groups[g].dma_chan);
+            pendingGroups &= ~(1u << g);
+            if (!pendingGroups) {
+                // when every group is done we start the reset delay timer
+                stats.output_us = (uint32_t) (time_us_64() - start_us);
+                stats.frames++;
+                if (latch_alarm) cancel_alarm(latch_alarm);
+                latch_alarm = add_alarm_in_us(WS2812_SET_LATCH_US, latch_done, NULL, true);
+            }
+        }
+    }
+}
+
+bool ws2812_set_add(strip_t *strip, uint pin, uint num_pixels, bool rgbw) {
+    if (numStrips >= WS2812_SET_MAX_STRIPS || pin >= NUM_BANK0_GPIOS) {
+        return false;
+    }
+    for (uint i = 0; i < numStrips; i++) {
+        if (strips[i]->pin == pin) return false;
+    }
+    strip->data_len = num_pixels * (rgbw ? 4 : 3);
+    strip->data = calloc(strip->data_len, 1);
+    if (!strip->data) {
+        return false;
+    }
+    strip->pin = pin;
+    strip->num_pixels = num_pixels;
+    strip->rgbw = rgbw;
+    strip->dither = true;
+    if (!strip->frac_brightness) {
+        strip->frac_brightness = 0x100;
+    }
+    strips[numStrips++] = strip;
+    return true;
+}
+
+static bool group_dma_init(group_t *g) {
+    int data = dma_claim_unused_channel(false);
+    int chain = dma_claim_unused_channel(false);
+    if (data < 0 || chain < 0) {
+        if (data >= 0) dma_channel_unclaim(data);
+        if (chain >= 0) dma_channel_unclaim(chain);
+        return false;
+    }
+    g->dma_chan = data;
+    g->chain_chan = chain;
+
+    // main DMA channel outputs 8 word fragments, and then chains back to the chain channel
+    dma_channel_config channel_config = dma_channel_get_default_config(g->dma_chan);
+    channel_config_set_dreq(&channel_config, pio_get_dreq(g->pio, g->sm, true));
+    channel_config_set_chain_to(&channel_config, g->chain_chan);
+    channel_config_set_irq_quiet(&channel_config, true);
+    dma_channel_configure(g->dma_chan,
+                          &channel_config,
+                          &g->pio->txf[g->sm],
+                          NULL, // set by chain
+                          8, // 8 words for 8 bit planes
+                          false);
+
+    // chain channel sends single word pointer to start of fragment each time,
+    // the 0 at the end is a null trigger which raises dma_chan's IRQ
+    dma_channel_config chain_config = dma_channel_get_default_config(g->chain_chan);
+    dma_channel_configure(g->chain_chan,
+                          &chain_config,
+                          &dma_channel_hw_addr(g->dma_chan)->al3_read_addr_trig,
+                          NULL, // set each frame
+                          1,
+                          false);
+    dma_channel_set_irq0_enabled(g->dma_chan, true);
+    return true;
+}
+
+static bool group_start(group_t *g) {
+    // This will find a free pio and state machine for our program and load it for us
+    if (!pio_claim_free_sm_and_add_program_for_gpio_range(&ws2812_parallel_program, &g->pio, &g->sm, &g->offset,
+                                                           g->pin_base, g->num_lanes, true)) {
+        printf("ws2812_set: no state machine for GP%u-%u\n", g->pin_base, g->pin_base + g->num_lanes - 1);
+        return false;
+    }
+    ws2812_parallel_program_init(g->pio, g->sm, g->offset, g->pin_base, g->num_lanes, 800000);
+
+    g->value_length = 0;
+    for (uint i = 0; i < g->num_lanes; i++) {
+        if (g->strips[i]->data_len > g->value_length) g->value_length = g->strips[i]->data_len;
+    }
+    for (int b = 0; b < 2; b++) {
+        g->states[b] = calloc(g->value_length, sizeof(value_bits_t));
+        g->fragments[b] = malloc((g->value_length + 1) * sizeof(uintptr_t));
+        if (!g->states[b] || !g->fragments[b]) {
+            printf("ws2812_set: out of memory for GP%u-%u\n", g->pin_base, g->pin_base + g->num_lanes - 1);
+            return false;
+        }
+        // the values never move, so the fragment lists are built once
+        for (uint v = 0; v < g->value_length; v++) {
+            g->fragments[b][v] = (uintptr_t) g->states[b][v].planes; // MSB first
+        }
+        g->fragments[b][g->value_length] = 0;
+    }
+
+    if (!group_dma_init(g)) {
+        printf("ws2812_set: out of DMA channels\n");
+        return false;
+    }
+    return true;
+}
+
+int ws2812_set_start(void) {
+    // sort by pin, then every run of consecutive pins (up to 32) is a group
+    for (uint i = 1; i < numStrips; i++) {
+        strip_t *s = strips[i];
+        uint j = i;
+        for (; j > 0 && strips[j - 1]->pin > s->pin; j--) {
+            strips[j] = strips[j - 1];
+        }
+        strips[j] = s;
+    }
+
+    numGroups = 0;
+    for (uint i = 0; i < numStrips; i++) {
+        group_t *g = numGroups ? &groups[numGroups - 1] : NULL;
+        if (!g || strips[i]->pin != g->pin_base + g->num_lanes || g->num_lanes == WS2812_LANES) {
+            if (numGroups == WS2812_SET_MAX_GROUPS) {
+                printf("ws2812_set: more than %d groups of pins\n", WS2812_SET_MAX_GROUPS);
+                return -1;
+            }
+            g = &groups[numGroups++];
+            memset(g, 0, sizeof(*g));
+            g->pin_base = strips[i]->pin;
+        }
+        g->strips[g->num_lanes++] = strips[i];
+    }
+
+    for (uint g = 0; g < numGroups; g++) {
+        if (!group_start(&groups[g])) {
+            return -1;
+        }
+    }
+
+    idleUa = 0;
+    for (uint i = 0; i < numStrips; i++) {
+        idleUa += strips[i]->num_pixels * WS2812_PIXEL_IDLE_UA;
+    }
+    stats.power_gain = POWER_GAIN_ONE >> 8;
+
+    sem_init(&latch_sem, 1, 1); // initially posted so we don't block first time
+    irq_add_shared_handler(DMA_IRQ_0, dma_complete_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+    irq_set_enabled(DMA_IRQ_0, true);
+    return numGroups;
+}
+
+void ws2812_set_power_budget(uint32_t budget_ma) {
+    powerBudgetUa = budget_ma * 1000;
+    if (!powerBudgetUa) {
+        powerGain = POWER_GAIN_ONE;
+    }
+}
+
+// total is every value of the frame just built, in steps, at powerGain: move the
+// gain towards what would have fitted the budget
+static void power_update(uint32_t total) {
+    uint32_t ua = (uint32_t) ((uint64_t) total * WS2812_CHANNEL_UA / 255);
+    stats.power_ma = (ua + idleUa) / 1000;
+    if (!powerBudgetUa) {
+        return;
+    }
+    uint32_t allowed = powerBudgetUa > idleUa ? powerBudgetUa - idleUa : 0;
+    uint32_t target = POWER_GAIN_ONE;
+    if (ua) {
+        uint64_t fit = (uint64_t) powerGain * allowed / ua;
+        if (fit < target) target = (uint32_t) fit;
+    }
+    // down within a few frames, back up over a few dozen
+    if (target < powerGain) {
+        powerGain -= (powerGain - target + 3) >> 2;
+    } else {
+        powerGain += (target - powerGain) >> 5;
+    }
+    stats.power_gain = powerGain >> 8;
+}
+
+void ws2812_set_show(uint frac_brightness) {
+    // build the next frame while the last one is still going out, then dither it
+    // with the error the last frame left
+    uint frac_bits = dither_get_frac_bits();
+    uint shift = dither_next_frame();
+    uint32_t total = 0;
+    frac_brightness = (uint32_t) (((uint64_t) frac_brightness * powerGain) >> 16);
+    for (uint i = 0; i < numGroups; i++) {
+        group_t *g = &groups[i];
+        uint32_t lanes = 0;
+        for (uint l = 0; l < g->num_lanes; l++) {
+            if (g->strips[l]->dither) lanes |= 1u << l;
+        }
+        total += transform_strips(g->strips, g->num_lanes, g->states[current], g->value_length, frac_brightness,
+                                  frac_bits);
+        dither_values(g->states[current], g->states[current ^ 1], g->value_length, lanes, shift);
+    }
+    power_update(total);
+
+    uint64_t t0 = time_us_64();
+    sem_acquire_blocking(&latch_sem);
+    stats.wait_us = (uint32_t) (time_us_64() - t0);
+    if (stats.wait_us > stats.max_wait_us) stats.max_wait_us = stats.wait_us;
+
+    // every group starts on the same DMA trigger
+    uint32_t mask = 0;
+    for (uint i = 0; i < numGroups; i++) {
+        dma_channel_set_read_addr(groups[i].chain_chan, groups[i].fragments[current], false);
+        mask |= 1u << groups[i].chain_chan;
+    }
+    pendingGroups = (1u << numGroups) - 1;
+    start_us = time_us_64();
+    dma_start_channel_mask(mask);
+    current ^= 1;
+}
+
+uint ws2812_set_num_groups(void) {
+    return numGroups;
+}
+
+uint32_t ws2812_set_frame_us(void) {
+    uint value_length = 0;
+    for (uint i = 0; i < numGroups; i++) {
+        if (groups[i].value_length > value_length) value_length = groups[i].value_length;
+    }
+    // 8 bits a value at 1.25us each
+    return value_length * 10 + WS2812_SET_LATCH_US;
+}
+
+void ws2812_set_get_stats(ws2812_set_stats_t *s) {
+    *s = stats;
+}
@@ -0,0 +1,70 @@
+#ifndef WS2812_SET_H__
+#define WS2812_SET_H__
+
+#include "pico/stdlib.h"
+#include "ws2812_planes.h"
+#include "ws2812_dither.h"
+
+// Any number of parallel WS2812 strips, RGB and RGBW, each its own length.
+// Add the strips with their pins, then ws2812_set_start() sorts them by pin and
+// splits them into groups of consecutive pins, up to 32 lanes each. Every group
+// gets a state machine running the ws2812_parallel program, on whichever PIO
+// block has room, plus two DMA channels. ws2812_set_show() builds every group's
+// bit planes into the back buffer while the last frame is still going out, waits
+// for that frame to latch, then starts all the groups with one DMA trigger so they
+// shift out in lockstep.
+//
+// A lane shifts out 24 (RGB) or 32 (RGBW) bits a pixel at 800kHz, so a group runs
+// at the speed of its longest strip: ~550 RGB pixels a lane for 60fps. Groups run
+// side by side, so more lanes, not longer strips, is how to get more pixels.
+
+#define WS2812_SET_MAX_STRIPS (NUM_PIOS * 4 * WS2812_LANES)
+#define WS2812_SET_MAX_GROUPS (NUM_PIOS * 4)
+// after the last group is done: >280us low to latch, plus what's still in the FIFOs
+#define WS2812_SET_LATCH_US   400
+// power model: a channel draws about 20mA at full, a pixel about 1mA lit or not
+#define WS2812_CHANNEL_UA     20000
+#define WS2812_PIXEL_IDLE_UA  1000
+
+typedef struct {
+    uint32_t frames;
+    uint32_t output_us;    // last frame, from the trigger until the last group finished
+    uint32_t wait_us;      // how long the last show() waited for the frame before to latch
+    uint32_t max_wait_us;
+    uint32_t power_ma;     // estimated for the last frame
+    uint32_t power_gain;   // what the limiter is scaling brightness by, 256 = not at all
+} ws2812_set_stats_t;
+
+// register a strip of num_pixels on pin, allocating its data (3 or 4 bytes a
+// pixel) and turning dithering on. Set strip->frac_brightness (256 = 1.0) as well.
+// Before ws2812_set_start()
+bool ws2812_set_add(strip_t *strip, uint pin, uint num_pixels, bool rgbw);
+// group the strips and claim state machines, DMA channels and plane buffers.
+// Returns the number of groups, or -1 if something ran out
+int ws2812_set_start(void);
+
+// pixel i of strip, bytes in the order put_pixel used (white left off on RGBW)
+static inline void ws2812_set_pixel(strip_t *strip, uint i, uint32_t pixel_grb) {
+    uint8_t *p = strip->data + i * (strip->rgbw ? 4 : 3);
+    p[0] = pixel_grb & 0xffu;
+    p[1] = (pixel_grb >> 8u) & 0xffu;
+    p[2] = (pixel_grb >> 16u) & 0xffu;
+    if (strip->rgbw) {
+        p[3] = 0;
+    }
+}
+
+// send what's in every strip's data, scaled by frac_brightness (BRIGHTNESS_ONE
+// is full) and dithered (ws2812_dither.h)
+void ws2812_set_show(uint frac_brightness);
+// keep the estimated current under budget_ma (0 for no limit). Each frame's current
+// is added up while its planes are built; when it's over, brightness comes down
+// over the next few frames, and goes back up slowly once there's room
+void ws2812_set_power_budget(uint32_t budget_ma);
+
+uint ws2812_set_num_groups(void);
+// how long a frame takes to go out and latch, set by the longest strip
+uint32_t ws2812_set_frame_us(void);
+void ws2812_set_get_stats(ws2812_set_stats_t *stats);
+
+#endif
@@ -0,0 +1,107 @@
+#include <stdio.h>
+
+#include "ws2812_stream.h"
+
+static const strip_t *streamStrips;
+static uint numStrips = 0;
+static uint totalLen = 0;
+static uint32_t frameUs;
+static bool live = false;
+static uint8_t lastSeq;
+static uint64_t lastFrame;
+static ws2812_stream_stats_t stats;
+
+// raw bytes from the USB serial, in as few calls as they arrive in
+static bool read_bytes(uint8_t *buf, uint len, absolute_time_t until) {
+    while (len) {
+        int n = stdio_get_until((char *) buf, (int) len, until);
+        if (n <= 0) {
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+// skip to just after the next 0xA5 0x5A
+static bool find_header(absolute_time_t until) {
+    uint8_t c, last = 0;
+    while (read_bytes(&c, 1, until)) {
+        if (last == WS2812_STREAM_MAGIC0 && c == WS2812_STREAM_MAGIC1) {
+            return true;
+        }
+        last = c;
+        // something is coming, give it time
+        until = make_timeout_time_us(WS2812_STREAM_TIMEOUT_US);
+    }
+    return false;
+}
+
+bool ws2812_stream_init(const strip_t *strips, uint num_strips, uint32_t frame_us) {
+    streamStrips = strips;
+    numStrips = num_strips;
+    frameUs = frame_us;
+    totalLen = 0;
+    for (uint s = 0; s < num_strips; s++) {
+        totalLen += strips[s].data_len;
+    }
+    // has to fit the 16 bit length
+    return totalLen <= 0xffff;
+}
+
+bool ws2812_stream_fill(uint8_t *const *data) {
+    // while nothing is coming just have a look, so the effects don't slow down
+    absolute_time_t until = live ? make_timeout_time_us(WS2812_STREAM_TIMEOUT_US) : get_absolute_time();
+    while (find_header(until)) {
+        absolute_time_t frame_until = make_timeout_time_us(WS2812_STREAM_TIMEOUT_US);
+        uint8_t head[3]; // seq, len
+        if (!read_bytes(head, sizeof(head), frame_until)) {
+            break;
+        }
+        if ((head[1] | head[2] << 8) != totalLen) {
+            stats.dropped++;
+            continue;
+        }
+        // straight into the back buffers
+        uint8_t sum = 0;
+        bool whole = true;
+        for (uint s = 0; s < numStrips && whole; s++) {
+            whole = read_bytes(data[s], streamStrips[s].data_len, frame_until);
+            for (uint i = 0; whole && i < streamStrips[s].data_len; i++) {
+                sum += data[s][i];
+            }
+        }
+        uint8_t check;
+        if (!whole || !read_bytes(&check, 1, frame_until)) {
+            break;
+        }
+        if (check != sum) {
+            stats.dropped++;
+            continue;
+        }
+
+        uint64_t now = time_us_64();
+        if (live) {
+            stats.dropped += (uint8_t) (head[0] - lastSeq - 1);
+            // USB jitter moves a frame a bit either way, late is half a frame past its slot
+            if (now - lastFrame > frameUs + frameUs / 2) {
+                stats.late++;
+            }
+        }
+        lastSeq = head[0];
+        lastFrame = now;
+        stats.received++;
+        live = true;
+        return true;
+    }
+    if (live) {
+        printf("ws2812_stream: PC stopped sending\n");
+    }
+    live = false;
+    return false;
+}
+
+void ws2812_stream_get_stats(ws2812_stream_stats_t *s) {
+    *s = stats;
+}
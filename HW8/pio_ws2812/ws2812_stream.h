@@ -0,0 +1,37 @@
+#ifndef WS2812_STREAM_H__
+#define WS2812_STREAM_H__
+
+#include "pico/stdlib.h"
+#include "ws2812_planes.h"
+
+// Frames from a PC over the USB serial, as an fx_source_fn (ws2812_fx.h).
+// A frame is
+//   0xA5 0x5A seq len_lo len_hi payload[len] sum
+// where the payload is every strip's bytes, strip after strip in the order given
+// to ws2812_stream_init(), exactly as they sit in strip->data and go out: 3 a
+// pixel, 4 for RGBW. len has to be the total of them, seq counts up by one a
+// frame and sum is the low byte of the sum of the payload.
+//
+// The payload is read straight into the back buffers core1 is handed, so a frame
+// is double buffered like any other: the next one lands while the last goes out.
+// While the PC sends, its frames replace the effects; once it stops for
+// WS2812_STREAM_TIMEOUT_US the effects come back.
+
+#define WS2812_STREAM_MAGIC0 0xA5
+#define WS2812_STREAM_MAGIC1 0x5A
+// the PC counts as gone after this long without a frame
+#define WS2812_STREAM_TIMEOUT_US 500000
+
+typedef struct {
+    uint32_t received;
+    uint32_t dropped; // bad length or sum, or missing from the seq count
+    uint32_t late;    // came more than 1.5 frame_us after the one before
+} ws2812_stream_stats_t;
+
+// frame_us is how often the PC should be sending, for counting late frames
+bool ws2812_stream_init(const strip_t *strips, uint num_strips, uint32_t frame_us);
+// core1: the fx source, true with a whole frame in data
+bool ws2812_stream_fill(uint8_t *const *data);
+void ws2812_stream_get_stats(ws2812_stream_stats_t *stats);
+
+#endif
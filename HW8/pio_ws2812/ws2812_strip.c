@@ -0,0 +1,71 @@
+#include "ws2812_strip.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+
+static ws2812_strip_t *strips[WS2812_MAX_STRIPS];
+static uint numStrips = 0;
+
+static int64_t latch_done(__unused alarm_id_t id, void *user_data) {
+    ws2812_strip_t *strip = (ws2812_strip_t *) user_data;
+    strip->latch_alarm = 0;
+    sem_release(&strip->ready);
+    // no repeat
+    return 0;
+}
+
+static void dma_complete_handler() {
+    for (uint i = 0; i < numStrips; i++) {
+        ws2812_strip_t *strip = strips[i];
+        if (dma_channel_get_irq0_status(strip->dma_chan)) {
+            dma_channel_acknowledge_irq0(strip->dma_chan);
+            // when the dma is complete we start the reset delay timer
+            if (strip->latch_alarm) cancel_alarm(strip->latch_alarm);
+            strip->latch_alarm = add_alarm_in_us(WS2812_LATCH_US, latch_done, strip, true);
+            strip->frames++;
+        }
+    }
+}
+
+void ws2812_strip_init(ws2812_strip_t *strip, PIO pio, uint sm, uint len) {
+    hard_assert(numStrips < WS2812_MAX_STRIPS);
+    strip->pio = pio;
+    strip->sm = sm;
+    strip->len = len;
+    strip->latch_alarm = 0;
+    strip->frames = 0;
+    sem_init(&strip->ready, 1, 1); // initially posted so we don't block first time
+
+    strip->dma_chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(strip->dma_chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_32);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, false);
+    channel_config_set_dreq(&c, pio_get_dreq(pio, sm, true));
+    dma_channel_configure(strip->dma_chan, &c, &pio->txf[sm], NULL, len, false);
+
+    if (numStrips == 0) {
+        irq_add_shared_handler(DMA_IRQ_0, dma_complete_handler, PICO_SHARED_IRQ_HANDLER_DEFAULT_ORDER_PRIORITY);
+        irq_set_enabled(DMA_IRQ_0, true);
+    }
+    strips[numStrips++] = strip;
+    dma_channel_set_irq0_enabled(strip->dma_chan, true);
+}
+
+void ws2812_strip_show(ws2812_strip_t *strip, const uint32_t *frame) {
+    sem_acquire_blocking(&strip->ready);
+    dma_channel_transfer_from_buffer_now(strip->dma_chan, frame, strip->len);
+}
+
+bool ws2812_strip_ready(ws2812_strip_t *strip) {
+    return sem_available(&strip->ready) > 0;
+}
+
+void ws2812_strip_wait(ws2812_strip_t *strip) {
+    sem_acquire_blocking(&strip->ready);
+    sem_release(&strip->ready);
+}
+
+uint32_t ws2812_frame_us(uint len, bool rgbw) {
+    // 1.25us a bit
+    return (len * (rgbw ? 32 : 24) * 5 + 3) / 4 + WS2812_LATCH_US;
+}
@@ -0,0 +1,43 @@
+#ifndef WS2812_STRIP_H__
+#define WS2812_STRIP_H__
+
+#include "pico/stdlib.h"
+#include "pico/sem.h"
+#include "hardware/pio.h"
+#include "ws2812_color.h"
+
+// One WS2812 strip fed by DMA.
+// A frame is an array of words exactly as the ws2812 program pulls them: the
+// colour in the top 24 bits for RGB strips (ws2812_rgb in ws2812_color.h), all
+// 32 bits for RGBW. show() points a DMA channel at the frame and returns; the
+// channel paces itself off the TX FIFO. When it finishes, an alarm holds off the
+// next frame for the reset latch. So the CPU only waits in show() if the previous
+// frame hasn't gone out yet, which is the strip's maximum frame rate. Don't touch
+// a frame while it's going out: draw the next one in a second buffer.
+
+#define WS2812_MAX_STRIPS 8
+// after the DMA is done: the last words still in the FIFO, then >280us low to latch
+#define WS2812_LATCH_US   400
+
+typedef struct {
+    PIO pio;
+    uint sm;
+    uint dma_chan;
+    uint len;                 // pixels
+    alarm_id_t latch_alarm;
+    struct semaphore ready;   // posted once the last frame has latched
+    volatile uint32_t frames;
+} ws2812_strip_t;
+
+// the state machine already running the ws2812 program (ws2812_program_init)
+void ws2812_strip_init(ws2812_strip_t *strip, PIO pio, uint sm, uint len);
+// wait for the last frame to latch, then start sending this one
+void ws2812_strip_show(ws2812_strip_t *strip, const uint32_t *frame);
+// the last frame is out and latched, show() won't wait
+bool ws2812_strip_ready(ws2812_strip_t *strip);
+void ws2812_strip_wait(ws2812_strip_t *strip);
+
+// us a frame of len pixels takes at 800kHz, latch included
+uint32_t ws2812_frame_us(uint len, bool rgbw);
+
+#endif
@@ -5,17 +5,44 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include "pico/stdlib.h"
 #include "pico/multicore.h"
 #include "hardware/adc.h"
 #include "hardware/gpio.h"
+#include "spsc_ring.h"
 
 #define FLAG_VALUE 123
 #define LED_PIN 15
+#define LINE_LEN 64
+
+// commands are the numbers typed in. Replies echo the command's type and tag,
+// with the voltage in arg.f for CMD_READ_VOLTAGE
+enum {
+    CMD_READ_VOLTAGE = 0,
+    CMD_LED_ON = 1,
+    CMD_LED_OFF = 2,
+};
 
-int command;
 const float conversion_factor = 3.3f / (1 << 12);
-float voltage;
+
+// core0 -> core1 and back, the SIO FIFO is only used to wake the other core up
+static spsc_ring_t commands;
+static spsc_ring_t results;
+
+// tell the other core a ring has something for it, or room in it. If our side
+// of the FIFO is full there's a wakeup waiting for it already
+static void doorbell(void) {
+    if (multicore_fifo_wready()) {
+        multicore_fifo_push_blocking(FLAG_VALUE);
+    }
+}
+
+// sleep until the other core rings, then check the rings again
+static void wait_doorbell(void) {
+    multicore_fifo_pop_blocking();
+    multicore_fifo_drain();
+}
 
 void core1_entry() {
 
@@ -30,23 +57,70 @@ void core1_entry() {
     multicore_fifo_push_blocking(FLAG_VALUE);
 
     while (1){
-        uint32_t com = multicore_fifo_pop_blocking();
+        // every command there's room to reply to, in one go
+        uint32_t n = spsc_ring_count(&commands);
+        uint32_t space = spsc_ring_space(&results);
+        if (n > space) n = space;
+        if (n == 0) {
+            wait_doorbell();
+            continue;
+        }
 
-        if (com == 0) {
-            //read voltage on A0
-            uint16_t adcVal = adc_read();
-            voltage = (float)(adcVal * conversion_factor);
+        for (uint32_t i = 0; i < n; i++) {
+            const ring_msg_t *cmd = spsc_ring_peek(&commands, i);
+            ring_msg_t *reply = spsc_ring_slot(&results, i);
+            reply->type = cmd->type;
+            reply->tag = cmd->tag;
+            reply->arg.u32 = 0;
+
+            if (cmd->type == CMD_READ_VOLTAGE) {
+                //read voltage on A0
+                uint16_t adcVal = adc_read();
+                reply->arg.f = (float)(adcVal * conversion_factor);
+            }
+            else if (cmd->type == CMD_LED_ON) {
+                //turn on GP15 LED
+                gpio_put(LED_PIN, 1);
+            }
+            else if (cmd->type == CMD_LED_OFF) {
+                //turn off GP15 LED
+                gpio_put(LED_PIN, 0);
+            }
         }
-        else if (com == 1) {
-            //turn on GP15 LED
-            gpio_put(LED_PIN, 1);
+
+        spsc_ring_complete(&commands, n);
+        spsc_ring_submit(&results, n);
+        doorbell();
+    }
+}
+
+static void read_line(char *buf, int len) {
+    int n = 0;
+    while (1) {
+        int c = getchar();
+        if (c == '\r' || c == '\n') {
+            if (n) break;
+            continue;
         }
-        else if (com == 2) {
-            //turn off GP15 LED
-            gpio_put(LED_PIN, 0);
+        if (n < len - 1) {
+            buf[n++] = (char)c;
         }
+    }
+    buf[n] = 0;
+}
 
-        multicore_fifo_push_blocking(FLAG_VALUE);
+static void print_result(const ring_msg_t *reply) {
+    if (reply->type == CMD_READ_VOLTAGE){
+        printf("#%u Voltage: %f\n\r", reply->tag, reply->arg.f);
+    }
+    else if (reply->type == CMD_LED_ON){
+        printf("#%u LED on!\n\r", reply->tag);
+    }
+    else if (reply->type == CMD_LED_OFF){
+        printf("#%u LED off!\n\r", reply->tag);
+    }
+    else {
+        printf("#%u Unknown command %u\n\r", reply->tag, reply->type);
     }
 }
 
@@ -59,6 +133,8 @@ int main() {
 
     /// \tag::setup_multicore[]
 
+    spsc_ring_init(&commands);
+    spsc_ring_init(&results);
     multicore_launch_core1(core1_entry);
 
     // Wait for it to start up
@@ -69,31 +145,58 @@ int main() {
         printf("Hmm, that's not right on core 0!\n");
     else {
 
+        static char line[LINE_LEN];
+        uint16_t tag = 0;
         while (1) {
-            printf("Enter a command: \n\r");
-            scanf("%d", &command);
-            printf("Command: %d\n\r", command);
-            multicore_fifo_push_blocking(command);
-
-            g = multicore_fifo_pop_blocking();
-
-            if (g != FLAG_VALUE){
-                printf("Hmm, that's not right on core 0!\n");
-            }
-            else if (command == 0){
-                printf("Voltage: %f\n\n\r", voltage);
+            printf("Enter commands: \n\r");
+            read_line(line, LINE_LEN);
+
+            // send the commands on the line as fast as the ring takes them and
+            // print the replies as they come back, core1 works while we parse
+            char *p = line;
+            bool more = true;
+            uint32_t outstanding = 0;
+            while (more || outstanding) {
+                uint32_t n = 0;
+                uint32_t space = spsc_ring_space(&commands);
+                while (more && n < space) {
+                    char *end;
+                    long command = strtol(p, &end, 10);
+                    if (end == p) {
+                        more = false;
+                        break;
+                    }
+                    p = end;
+                    ring_msg_t *cmd = spsc_ring_slot(&commands, n++);
+                    cmd->type = (uint16_t)command;
+                    cmd->tag = tag++;
+                    cmd->arg.u32 = 0;
+                    printf("#%u Command: %ld\n\r", cmd->tag, command);
+                }
+                if (n) {
+                    spsc_ring_submit(&commands, n);
+                    doorbell();
+                    outstanding += n;
+                }
+
+                uint32_t done = spsc_ring_count(&results);
+                for (uint32_t i = 0; i < done; i++) {
+                    print_result(spsc_ring_peek(&results, i));
+                }
+                if (done) {
+                    spsc_ring_complete(&results, done);
+                    doorbell(); // core1 may be waiting for room
+                    outstanding -= done;
+                }
+                else if (!n && outstanding) {
+                    wait_doorbell();
+                }
             }
-            else if (command == 1){
-                printf("LED on!\n\n\r");
-            }
-            else if (command == 2){
-                printf("LED off!\n\n\r");
-            }
-            sleep_ms(500);
+            printf("\n\r");
         }
 
     }
-    
+
 
     /// \end::setup_multicore[]
 }
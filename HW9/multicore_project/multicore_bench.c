@@ -0,0 +1,256 @@
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "pico/util/queue.h"
+#include "spsc_ring.h"
+
+// What it costs to get a message from one core to the other, for each way we
+// have of doing it. Round trip: core0 sends, core1 sends the same message back,
+// one way is half of that. Stream: core0 sends as fast as it can while core1
+// takes them; a seqlock only keeps the latest message, so it also says how many
+// got through.
+
+#define MAX_WORDS 16
+#define PING_PONGS 10000
+#define STREAM_MSGS 50000
+#define QUEUE_DEPTH 16
+
+// chan 0 is core0 to core1, chan 1 back again. send and recv wait until they can
+typedef struct {
+    const char *name;
+    void (*reset)(uint words);
+    void (*send)(uint chan, const uint32_t *msg, uint words);
+    void (*recv)(uint chan, uint32_t *msg, uint words);
+} transport_t;
+
+// SIO FIFO, a word at a time
+static void fifo_reset(uint words) {
+    multicore_fifo_drain();
+}
+
+static void fifo_send(uint chan, const uint32_t *msg, uint words) {
+    for (uint w = 0; w < words; w++) {
+        multicore_fifo_push_blocking(msg[w]);
+    }
+}
+
+static void fifo_recv(uint chan, uint32_t *msg, uint words) {
+    for (uint w = 0; w < words; w++) {
+        msg[w] = multicore_fifo_pop_blocking();
+    }
+}
+
+// the SDK queue, a hardware spinlock around a copy in and out
+static queue_t queues[2];
+static bool queuesInit = false;
+
+static void queue_reset(uint words) {
+    for (int c = 0; c < 2; c++) {
+        if (queuesInit) queue_free(&queues[c]);
+        queue_init(&queues[c], words * sizeof(uint32_t), QUEUE_DEPTH);
+    }
+    queuesInit = true;
+}
+
+static void queue_send(uint chan, const uint32_t *msg, uint words) {
+    queue_add_blocking(&queues[chan], msg);
+}
+
+static void queue_recv(uint chan, uint32_t *msg, uint words) {
+    queue_remove_blocking(&queues[chan], msg);
+}
+
+// spsc_ring.h, a message spread over as many slots as it needs and submitted
+// in one go, polled rather than waiting for a doorbell
+#define RING_SLOT_WORDS (sizeof(ring_msg_t) / sizeof(uint32_t))
+static spsc_ring_t rings[2];
+
+static void ring_reset(uint words) {
+    spsc_ring_init(&rings[0]);
+    spsc_ring_init(&rings[1]);
+}
+
+static void ring_send(uint chan, const uint32_t *msg, uint words) {
+    spsc_ring_t *r = &rings[chan];
+    uint32_t slots = (words + RING_SLOT_WORDS - 1) / RING_SLOT_WORDS;
+    while (spsc_ring_space(r) < slots) {
+        tight_loop_contents();
+    }
+    for (uint32_t i = 0; i < slots; i++, words -= RING_SLOT_WORDS) {
+        memcpy(spsc_ring_slot(r, i), msg + i * RING_SLOT_WORDS,
+               (words < RING_SLOT_WORDS ? words : RING_SLOT_WORDS) * sizeof(uint32_t));
+    }
+    spsc_ring_submit(r, slots);
+}
+
+static void ring_recv(uint chan, uint32_t *msg, uint words) {
+    spsc_ring_t *r = &rings[chan];
+    uint32_t slots = (words + RING_SLOT_WORDS - 1) / RING_SLOT_WORDS;
+    while (spsc_ring_count(r) < slots) {
+        tight_loop_contents();
+    }
+    for (uint32_t i = 0; i < slots; i++, words -= RING_SLOT_WORDS) {
+        memcpy(msg + i * RING_SLOT_WORDS, spsc_ring_peek(r, i),
+               (words < RING_SLOT_WORDS ? words : RING_SLOT_WORDS) * sizeof(uint32_t));
+    }
+    spsc_ring_complete(r, slots);
+}
+
+// seqlock: the writer makes seq odd while it copies in and even again after, the
+// reader copies out and tries again if seq moved. The writer never waits
+typedef struct {
+    uint32_t seq;
+    uint32_t data[MAX_WORDS];
+} seqlock_t;
+
+static seqlock_t seqlocks[2];
+static uint32_t seqSeen[2]; // last seq each chan's reader took
+
+static void seqlock_reset(uint words) {
+    memset(seqlocks, 0, sizeof(seqlocks));
+    seqSeen[0] = seqSeen[1] = 0;
+}
+
+static void seqlock_send(uint chan, const uint32_t *msg, uint words) {
+    seqlock_t *s = &seqlocks[chan];
+    uint32_t seq = s->seq;
+    __atomic_store_n(&s->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (uint w = 0; w < words; w++) {
+        __atomic_store_n(&s->data[w], msg[w], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&s->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+static void seqlock_recv(uint chan, uint32_t *msg, uint words) {
+    seqlock_t *s = &seqlocks[chan];
+    while (true) {
+        uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_ACQUIRE);
+        if ((seq & 1) || seq == seqSeen[chan]) {
+            tight_loop_contents();
+            continue;
+        }
+        for (uint w = 0; w < words; w++) {
+            msg[w] = __atomic_load_n(&s->data[w], __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&s->seq, __ATOMIC_RELAXED) == seq) {
+            seqSeen[chan] = seq;
+            return;
+        }
+    }
+}
+
+static const transport_t transports[] = {
+        {"SIO FIFO",       fifo_reset,    fifo_send,    fifo_recv},
+        {"spinlock queue", queue_reset,   queue_send,   queue_recv},
+        {"SPSC ring",      ring_reset,    ring_send,    ring_recv},
+        {"seqlock",        seqlock_reset, seqlock_send, seqlock_recv},
+};
+
+static const uint sizes[] = {4, 16, 64}; // bytes
+
+// what core1 is to do next
+static const transport_t *benchTransport;
+static uint benchWords;
+static bool benchStream;
+static uint32_t core1Received;
+static bool core1Done;
+
+static void core1_bench(void) {
+    const transport_t *t = benchTransport;
+    uint32_t msg[MAX_WORDS];
+    if (benchStream) {
+        // until the last one, however many of them that was
+        uint32_t received = 0;
+        do {
+            t->recv(0, msg, benchWords);
+            received++;
+        } while (msg[0] != STREAM_MSGS - 1);
+        core1Received = received;
+    } else {
+        for (int i = 0; i < PING_PONGS; i++) {
+            t->recv(0, msg, benchWords);
+            t->send(1, msg, benchWords);
+        }
+    }
+    __atomic_store_n(&core1Done, true, __ATOMIC_RELEASE);
+    while (1) {
+        tight_loop_contents();
+    }
+}
+
+static void start_core1(const transport_t *t, uint words, bool stream) {
+    multicore_reset_core1();
+    t->reset(words);
+    benchTransport = t;
+    benchWords = words;
+    benchStream = stream;
+    core1Received = 0;
+    core1Done = false;
+    multicore_launch_core1(core1_bench);
+}
+
+static void wait_core1(void) {
+    while (!__atomic_load_n(&core1Done, __ATOMIC_ACQUIRE)) {
+        tight_loop_contents();
+    }
+}
+
+// ns for a message there and back
+static uint32_t round_trip_ns(const transport_t *t, uint words) {
+    uint32_t msg[MAX_WORDS] = {0};
+    start_core1(t, words, false);
+    uint64_t t0 = time_us_64();
+    for (int i = 0; i < PING_PONGS; i++) {
+        msg[0] = i;
+        t->send(0, msg, words);
+        t->recv(1, msg, words);
+    }
+    uint64_t us = time_us_64() - t0;
+    wait_core1();
+    return (uint32_t)(us * 1000 / PING_PONGS);
+}
+
+// messages a second that got to core1, and how many of the STREAM_MSGS that was
+static uint32_t stream_rate(const transport_t *t, uint words, uint32_t *delivered) {
+    uint32_t msg[MAX_WORDS] = {0};
+    start_core1(t, words, true);
+    uint64_t t0 = time_us_64();
+    for (uint32_t i = 0; i < STREAM_MSGS; i++) {
+        msg[0] = i;
+        t->send(0, msg, words);
+    }
+    wait_core1();
+    uint64_t us = time_us_64() - t0;
+    *delivered = core1Received;
+    return (uint32_t)((uint64_t)core1Received * 1000000 / us);
+}
+
+int main() {
+    stdio_init_all();
+
+    while (!stdio_usb_connected()) {
+        sleep_ms(100);
+    }
+
+    printf("core to core, %d round trips and %d streamed messages each\n", PING_PONGS, STREAM_MSGS);
+    printf("%-16s %5s %10s %9s %10s %9s\n", "transport", "bytes", "trip ns", "one way", "msgs/s", "got");
+    for (uint i = 0; i < count_of(transports); i++) {
+        for (uint s = 0; s < count_of(sizes); s++) {
+            uint words = sizes[s] / sizeof(uint32_t);
+            uint32_t trip = round_trip_ns(&transports[i], words);
+            uint32_t delivered;
+            uint32_t rate = stream_rate(&transports[i], words, &delivered);
+            printf("%-16s %5u %10lu %9lu %10lu %8lu%%\n", transports[i].name, sizes[s], (unsigned long)trip,
+                   (unsigned long)(trip / 2), (unsigned long)rate,
+                   (unsigned long)((uint64_t)delivered * 100 / STREAM_MSGS));
+        }
+    }
+    multicore_reset_core1();
+
+    while (1) {
+        sleep_ms(1000);
+    }
+}
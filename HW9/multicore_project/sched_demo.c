@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/adc.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "task_sched.h"
+
+// The HW9 jobs as tasks instead of a command loop: the LED and the stats stay on
+// core0, the ADC is sampled on core1, and a few lumps of number crunching all
+// start out on core0 so core1 has to take them when it's free.
+
+#define LED_PIN 15
+#define NUM_WORKERS 3
+#define WORK_BYTES 2048
+
+const float conversion_factor = 3.3f / (1 << 12);
+
+static sched_task_t ledTask, adcTask, statsTask;
+static sched_task_t workTasks[NUM_WORKERS];
+static const char *workNames[NUM_WORKERS] = {"crc0", "crc1", "crc2"};
+
+// adc_task adds on core1 while stats_task takes them on core0
+static spin_lock_t *adcLock;
+static uint32_t adcSum;
+static uint adcCount;
+static uint8_t workData[WORK_BYTES];
+static uint32_t workResults[NUM_WORKERS];
+
+static void led_task(void *arg) {
+    gpio_put(LED_PIN, !gpio_get(LED_PIN));
+}
+
+static void adc_task(void *arg) {
+    uint16_t sample = adc_read();
+    uint32_t save = spin_lock_blocking(adcLock);
+    adcSum += sample;
+    adcCount++;
+    spin_unlock(adcLock, save);
+}
+
+// a bitwise CRC32 of the buffer, about 1ms of work
+static void work_task(void *arg) {
+    uint32_t *result = arg;
+    uint32_t crc = 0xffffffffu;
+    for (uint i = 0; i < WORK_BYTES; i++) {
+        crc ^= workData[i];
+        for (int b = 0; b < 8; b++) {
+            crc = (crc >> 1) ^ (0xedb88320u & -(crc & 1u));
+        }
+    }
+    *result = ~crc;
+}
+
+static void stats_task(void *arg) {
+    uint32_t save = spin_lock_blocking(adcLock);
+    uint32_t sum = adcSum;
+    uint count = adcCount;
+    adcSum = 0;
+    adcCount = 0;
+    spin_unlock(adcLock, save);
+    if (count) {
+        printf("Voltage: %f\n", sum * conversion_factor / count);
+    }
+    sched_print_stats();
+    printf("\n");
+}
+
+int main() {
+    stdio_init_all();
+
+    while (!stdio_usb_connected()) {
+        sleep_ms(100);
+    }
+
+    adc_init();
+    adc_gpio_init(26);
+    adc_select_input(0);
+
+    gpio_init(LED_PIN);
+    gpio_set_dir(LED_PIN, GPIO_OUT);
+    gpio_put(LED_PIN, 0);
+
+    for (uint i = 0; i < WORK_BYTES; i++) {
+        workData[i] = i * 7;
+    }
+
+    adcLock = spin_lock_init(spin_lock_claim_unused(true));
+    sched_init();
+    sched_task_init(&ledTask, "led", led_task, NULL);
+    sched_add(&ledTask, 0, 0, 250000, true);
+    sched_task_init(&adcTask, "adc", adc_task, NULL);
+    sched_add(&adcTask, 1, 0, 1000, true);
+    for (int w = 0; w < NUM_WORKERS; w++) {
+        sched_task_init(&workTasks[w], workNames[w], work_task, &workResults[w]);
+        sched_add(&workTasks[w], 0, w * 1000, 4000, false);
+    }
+    sched_task_init(&statsTask, "stats", stats_task, NULL);
+    sched_add(&statsTask, 0, 2000000, 2000000, true);
+
+    sched_start();
+}
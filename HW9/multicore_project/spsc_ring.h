@@ -0,0 +1,96 @@
+#ifndef SPSC_RING_H__
+#define SPSC_RING_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Single producer, single consumer ring of messages in shared RAM, one per
+// direction between the cores. Only the producer writes head and only the
+// consumer writes tail, so neither side ever takes a lock: the producer fills
+// slots past head and then publishes them all with one store (release), the
+// consumer sees them with one load (acquire), works through them in place and
+// hands them all back the same way. Nothing in here is Pico specific, so it
+// builds on a PC too, where spsc_ring_test.c runs it between two threads:
+//   gcc -O2 -pthread -o spsc_ring_test spsc_ring_test.c && ./spsc_ring_test
+//
+// Producer:                           Consumer:
+//   n = spsc_ring_space(r)              n = spsc_ring_count(r)
+//   fill spsc_ring_slot(r, 0..n-1)      read spsc_ring_peek(r, 0..n-1)
+//   spsc_ring_submit(r, n)              spsc_ring_complete(r, n)
+
+#define SPSC_RING_SIZE 16 // power of two
+
+#if SPSC_RING_SIZE & (SPSC_RING_SIZE - 1)
+#error SPSC_RING_SIZE has to be a power of two
+#endif
+
+typedef struct {
+    uint16_t type;
+    uint16_t tag; // the producer's sequence number, echoed in replies
+    union {
+        uint32_t u32;
+        float f;
+    } arg;
+} ring_msg_t;
+
+typedef struct {
+    uint32_t head; // free running, producer only
+    uint32_t tail; // free running, consumer only
+    ring_msg_t slots[SPSC_RING_SIZE];
+} spsc_ring_t;
+
+static inline void spsc_ring_init(spsc_ring_t *r) {
+    r->head = 0;
+    r->tail = 0;
+}
+
+// producer: how many slots can be filled
+static inline uint32_t spsc_ring_space(const spsc_ring_t *r) {
+    return SPSC_RING_SIZE - (r->head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE));
+}
+
+// producer: the i'th free slot
+static inline ring_msg_t *spsc_ring_slot(spsc_ring_t *r, uint32_t i) {
+    return &r->slots[(r->head + i) & (SPSC_RING_SIZE - 1)];
+}
+
+// producer: publish the first n free slots
+static inline void spsc_ring_submit(spsc_ring_t *r, uint32_t n) {
+    __atomic_store_n(&r->head, r->head + n, __ATOMIC_RELEASE);
+}
+
+// consumer: how many messages are waiting
+static inline uint32_t spsc_ring_count(const spsc_ring_t *r) {
+    return __atomic_load_n(&r->head, __ATOMIC_ACQUIRE) - r->tail;
+}
+
+// consumer: the i'th waiting message
+static inline const ring_msg_t *spsc_ring_peek(const spsc_ring_t *r, uint32_t i) {
+    return &r->slots[(r->tail + i) & (SPSC_RING_SIZE - 1)];
+}
+
+// consumer: done with the first n, the producer can have them back
+static inline void spsc_ring_complete(spsc_ring_t *r, uint32_t n) {
+    __atomic_store_n(&r->tail, r->tail + n, __ATOMIC_RELEASE);
+}
+
+// one at a time
+static inline bool spsc_ring_push(spsc_ring_t *r, const ring_msg_t *msg) {
+    if (!spsc_ring_space(r)) {
+        return false;
+    }
+    *spsc_ring_slot(r, 0) = *msg;
+    spsc_ring_submit(r, 1);
+    return true;
+}
+
+static inline bool spsc_ring_pop(spsc_ring_t *r, ring_msg_t *msg) {
+    if (!spsc_ring_count(r)) {
+        return false;
+    }
+    *msg = *spsc_ring_peek(r, 0);
+    spsc_ring_complete(r, 1);
+    return true;
+}
+
+#endif
@@ -0,0 +1,100 @@
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include "spsc_ring.h"
+
+// The rings on a PC: one thread produces, the main thread consumes, like the two
+// cores. Every message has to come out once, in order, with what was put in, and
+// both the batch and the one at a time calls get used.
+//   gcc -O2 -pthread -o spsc_ring_test spsc_ring_test.c && ./spsc_ring_test
+
+#define MESSAGES 2000000u
+
+static spsc_ring_t ring;
+
+// batches of 1 up to a ring full, every 7th message on its own through push
+static void *producer(void *arg) {
+    (void) arg;
+    uint32_t sent = 0;
+    uint32_t batch = 1;
+    while (sent < MESSAGES) {
+        if (sent % 7 == 0) {
+            ring_msg_t msg = {.type = 1, .tag = (uint16_t) sent, .arg.u32 = sent};
+            if (spsc_ring_push(&ring, &msg)) {
+                sent++;
+            } else {
+                sched_yield();
+            }
+            continue;
+        }
+        uint32_t n = spsc_ring_space(&ring);
+        if (!n) {
+            // one CPU is enough to run this, let the consumer in
+            sched_yield();
+            continue;
+        }
+        if (n > batch) n = batch;
+        if (n > MESSAGES - sent) n = MESSAGES - sent;
+        for (uint32_t i = 0; i < n; i++) {
+            ring_msg_t *msg = spsc_ring_slot(&ring, i);
+            msg->type = 0;
+            msg->tag = (uint16_t) (sent + i);
+            msg->arg.u32 = sent + i;
+        }
+        spsc_ring_submit(&ring, n);
+        sent += n;
+        batch = batch % SPSC_RING_SIZE + 1;
+    }
+    return NULL;
+}
+
+static bool check(const ring_msg_t *msg, uint32_t want) {
+    if (msg->arg.u32 != want || msg->tag != (uint16_t) want) {
+        printf("FAIL expected %lu, got %lu tag %u\n", (unsigned long) want, (unsigned long) msg->arg.u32,
+               msg->tag);
+        return false;
+    }
+    return true;
+}
+
+int main(void) {
+    spsc_ring_init(&ring);
+    pthread_t thread;
+    pthread_create(&thread, NULL, producer, NULL);
+
+    uint32_t want = 0;
+    uint32_t popped = 0;
+    for (uint32_t round = 0; want < MESSAGES; round++) {
+        // every 3rd time take one, otherwise everything that's there
+        if (round % 3 == 0) {
+            ring_msg_t msg;
+            if (!spsc_ring_pop(&ring, &msg)) {
+                sched_yield();
+                continue;
+            }
+            if (!check(&msg, want++)) return 1;
+            popped++;
+            continue;
+        }
+        uint32_t n = spsc_ring_count(&ring);
+        if (!n) {
+            sched_yield();
+            continue;
+        }
+        if (n > SPSC_RING_SIZE) {
+            printf("FAIL %lu waiting in a ring of %d\n", (unsigned long) n, SPSC_RING_SIZE);
+            return 1;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            if (!check(spsc_ring_peek(&ring, i), want++)) return 1;
+        }
+        spsc_ring_complete(&ring, n);
+    }
+    pthread_join(thread, NULL);
+    if (spsc_ring_count(&ring)) {
+        printf("FAIL messages left over\n");
+        return 1;
+    }
+    printf("ring ok, %u messages, %lu popped one at a time\n", MESSAGES, (unsigned long) popped);
+    return 0;
+}
@@ -0,0 +1,182 @@
+#include <stdio.h>
+#include "task_sched.h"
+#include "pico/multicore.h"
+#include "hardware/sync.h"
+
+typedef struct {
+    sched_task_t *head; // sorted by due_us
+    spin_lock_t *lock;
+    uint64_t busy_us;
+    uint32_t steals;    // tasks this core took from the other
+} run_queue_t;
+
+static run_queue_t queues[NUM_CORES];
+static sched_task_t *allTasks;
+static uint64_t startUs;
+
+// A task's running and readded flags and its schedule only change under its
+// home queue's lock (queues[t->core]), so a sched_add from the other core either
+// finds it running and leaves it to run(), or finds it done and queues it itself
+
+// q's lock held
+static void insert(run_queue_t *q, sched_task_t *t) {
+    sched_task_t **p = &q->head;
+    while (*p && (*p)->due_us <= t->due_us) {
+        p = &(*p)->next;
+    }
+    t->next = *p;
+    *p = t;
+}
+
+static void push(sched_task_t *t) {
+    run_queue_t *q = &queues[t->core];
+    uint32_t save = spin_lock_blocking(q->lock);
+    insert(q, t);
+    spin_unlock(q->lock, save);
+    // either core may be asleep waiting for it
+    __sev();
+}
+
+// take the first task due by now, skipping pinned ones when stealing. Otherwise
+// lower next_due to when the first one will be
+static sched_task_t *pop_due(run_queue_t *q, uint64_t now, bool stealing, uint64_t *next_due) {
+    sched_task_t *t = NULL;
+    uint32_t save = spin_lock_blocking(q->lock);
+    for (sched_task_t **p = &q->head; *p; p = &(*p)->next) {
+        if (stealing && (*p)->pinned) {
+            continue;
+        }
+        if ((*p)->due_us > now) {
+            if ((*p)->due_us < *next_due) *next_due = (*p)->due_us;
+            break;
+        }
+        t = *p;
+        *p = t->next;
+        t->running = true;
+        break;
+    }
+    spin_unlock(q->lock, save);
+    return t;
+}
+
+// pop_due has marked t running
+static void run(sched_task_t *t, uint core) {
+    // a sched_add while it runs may move it, it came off this one
+    run_queue_t *home = &queues[t->core];
+    uint64_t t0 = time_us_64();
+    t->fn(t->arg);
+    uint64_t t1 = time_us_64();
+
+    uint32_t us = (uint32_t) (t1 - t0);
+    t->runs++;
+    t->total_us += us;
+    if (us > t->max_us) t->max_us = us;
+    if (&queues[core] != home) t->stolen++;
+    queues[core].busy_us += us;
+
+    uint32_t save = spin_lock_blocking(home->lock);
+    t->running = false;
+    bool again = true;
+    if (t->readded) {
+        t->readded = false;
+    } else if (t->period_us) {
+        t->due_us += t->period_us;
+        if (t->due_us < t1) {
+            // don't try to catch up
+            t->late++;
+            t->due_us = t1;
+        }
+    } else {
+        again = false;
+    }
+    // back on the same queue before anyone else can touch it, a readded task
+    // moved to the other core goes there once this lock is let go
+    bool moved = &queues[t->core] != home;
+    if (again && !moved) insert(home, t);
+    spin_unlock(home->lock, save);
+    if (again && moved) {
+        push(t);
+    } else if (again) {
+        __sev();
+    }
+}
+
+static void sched_loop(void) {
+    uint core = get_core_num();
+    run_queue_t *own = &queues[core];
+    run_queue_t *other = &queues[core ^ 1];
+    while (true) {
+        uint64_t now = time_us_64();
+        uint64_t next_due = UINT64_MAX;
+        sched_task_t *t = pop_due(own, now, false, &next_due);
+        if (!t) {
+            t = pop_due(other, now, true, &next_due);
+            if (t) own->steals++;
+        }
+        if (t) {
+            run(t, core);
+        } else if (next_due != UINT64_MAX) {
+            best_effort_wfe_or_timeout(from_us_since_boot(next_due));
+        } else {
+            __wfe();
+        }
+    }
+}
+
+static void core1_entry(void) {
+    sched_loop();
+}
+
+void sched_init(void) {
+    for (uint c = 0; c < NUM_CORES; c++) {
+        queues[c].lock = spin_lock_init(spin_lock_claim_unused(true));
+    }
+}
+
+void sched_task_init(sched_task_t *t, const char *name, sched_fn fn, void *arg) {
+    *t = (sched_task_t) {.name = name, .fn = fn, .arg = arg};
+    t->all_next = allTasks;
+    allTasks = t;
+}
+
+void sched_add(sched_task_t *t, uint core, uint32_t delay_us, uint32_t period_us, bool pinned) {
+    run_queue_t *home = &queues[t->core];
+    uint32_t save = spin_lock_blocking(home->lock);
+    t->core = core;
+    t->pinned = pinned;
+    t->period_us = period_us;
+    t->due_us = time_us_64() + delay_us;
+    bool running = t->running;
+    if (running) {
+        // from its own fn or the other core, run() puts it back when fn returns,
+        // so it can't start on the other core first
+        t->readded = true;
+    }
+    spin_unlock(home->lock, save);
+    if (!running) {
+        push(t);
+    }
+}
+
+void sched_start(void) {
+    startUs = time_us_64();
+    multicore_launch_core1(core1_entry);
+    sched_loop();
+}
+
+void sched_print_stats(void) {
+    uint64_t elapsed = time_us_64() - startUs;
+    if (!elapsed) return;
+    printf("%-10s %4s %8s %7s %7s %6s %5s %5s\n", "task", "core", "runs", "avg us", "max us", "stolen", "late",
+           "load");
+    for (sched_task_t *t = allTasks; t; t = t->all_next) {
+        printf("%-10s %4u %8lu %7lu %7lu %6lu %5lu %4lu%%\n", t->name, t->core, (unsigned long) t->runs,
+               (unsigned long) (t->runs ? t->total_us / t->runs : 0), (unsigned long) t->max_us,
+               (unsigned long) t->stolen, (unsigned long) t->late,
+               (unsigned long) (t->total_us * 100 / elapsed));
+    }
+    for (uint c = 0; c < NUM_CORES; c++) {
+        printf("core %u: %lu%% busy, %lu tasks taken from the other core\n", c,
+               (unsigned long) (queues[c].busy_us * 100 / elapsed), (unsigned long) queues[c].steals);
+    }
+}
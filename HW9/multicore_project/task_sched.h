@@ -0,0 +1,53 @@
+#ifndef TASK_SCHED_H__
+#define TASK_SCHED_H__
+
+#include "pico/stdlib.h"
+
+// Run to completion tasks on both cores.
+// Each core has a run queue sorted by when its tasks are due, behind a hardware
+// spinlock. A core runs the first due task on its own queue; if nothing of its
+// own is due it takes a due task off the other core's queue (unless it's pinned
+// there), so work that was put on a busy core gets done by an idle one. A task
+// runs on one core at a time and goes back on its own queue after. With nothing
+// due anywhere a core sleeps in WFE until the next task is or a new one is added.
+//
+// Tasks must return quickly (no sleep_ms): anything waiting is another task,
+// timed or periodic.
+
+typedef void (*sched_fn)(void *arg);
+
+typedef struct sched_task {
+    const char *name;
+    sched_fn fn;
+    void *arg;
+    uint core;            // whose queue it goes back on
+    bool pinned;          // never run by the other core
+    uint32_t period_us;   // 0 for once
+    uint64_t due_us;
+    bool running;
+    bool readded;         // added again while running, goes back once it returns
+    struct sched_task *next;
+    struct sched_task *all_next;
+    // accounting
+    uint32_t runs;
+    uint32_t stolen;      // runs on the other core
+    uint32_t late;        // periods missed because the last run finished too late
+    uint32_t max_us;
+    uint64_t total_us;
+} sched_task_t;
+
+void sched_init(void);
+// t's storage is the caller's, for as long as it's scheduled
+void sched_task_init(sched_task_t *t, const char *name, sched_fn fn, void *arg);
+// run t (not already queued) on core after delay_us, then every period_us (0 for
+// once). Any core can add tasks, a task can add itself again. A task added while
+// it runs (from its fn or the other core) goes back with the new schedule once
+// fn returns, and counts as queued from then on
+void sched_add(sched_task_t *t, uint core, uint32_t delay_us, uint32_t period_us, bool pinned);
+// start core1 and run the tasks on this one, never returns
+void sched_start(void);
+
+// per task run time and per core load since sched_start()
+void sched_print_stats(void);
+
+#endif